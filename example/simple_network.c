@@ -112,8 +112,20 @@ int main(int argc, char **argv)
 
 	fix16_t actual_output;
 
+	struct uneural_dataset dataset = {
+		.count = 4,
+		.inputs = &inputs[0][0],
+		.targets = &expected_outputs[0][0],
+	};
+
+	struct uneural_train_params params = {
+		.epochs = NET_PRINTOUT_PERIOD,
+		.rate = LEARNING_RATE,
+		.shuffle_seed = 1,
+	};
+
 	/* Create training scratchpad space */
-	ssize_t scratch_size = uneural_network_get_training_scratch_size(&network);
+	ssize_t scratch_size = uneural_train_get_scratch_size(&network, &dataset);
 
 	if (scratch_size < 0) {
 		printf("Unable to get scratch size\n");
@@ -121,7 +133,7 @@ int main(int argc, char **argv)
 	}
 
 
-	fix16_t *training_scratch = malloc(scratch_size);
+	void *training_scratch = malloc(scratch_size);
 
 	if (training_scratch == NULL) {
 		printf("Unable to allocate scratch area\n");
@@ -138,38 +150,34 @@ int main(int argc, char **argv)
 		       fix16_to_float(actual_output));
 	}
 
-	/* Train the neural network */
+	/* Train the neural network, reporting progress every
+	 * NET_PRINTOUT_PERIOD epochs */
+	fix16_t epoch_loss[NET_PRINTOUT_PERIOD];
 
-	for (int i = 0; i < TRAINING_ITERATIONS; i++) {
-		fix16_t global_error = 0;
-		for (int j = 0; j < 4; j++) {
-			fix16_t local_error = 0;
-			uneural_network_backprop(&network,
-						 inputs[j],
-						 expected_outputs[j],
-						 LEARNING_RATE,
-						 training_scratch,
-						 &local_error);
+	for (int i = 0; i < TRAINING_ITERATIONS; i += NET_PRINTOUT_PERIOD) {
+		uint32_t epochs_run;
+		int result = uneural_train_epochs(&network, &dataset, &params,
+						  training_scratch, epoch_loss,
+						  &epochs_run);
 
-			global_error = fix16_add(global_error,
-						 fix16_sq(local_error));
+		if (result) {
+			printf("Training failed: %d\n", result);
+			exit(-1);
 		}
 
-		if ((i % NET_PRINTOUT_PERIOD) == 0) {
-			printf("Iteration: %d\n", i);
-			printf("Global Error: %f\n", fix16_to_float(global_error));
-			fix16_t rmse = fix16_sqrt(fix16_sdiv(global_error, F16(4)));
-			printf("RMSE: %f\n", fix16_to_float(rmse));
-
-			for (int j = 0; j < 4; j++) {
-				uneural_activate_network(&network,
-							 inputs[j],
-							 &actual_output);
-				printf("Actual output %d - %f \n", j,
-				       fix16_to_float(actual_output));
-			}
-		}
+		fix16_t mse = epoch_loss[epochs_run - 1];
+
+		printf("Iteration: %d\n", i + epochs_run);
+		printf("MSE: %f\n", fix16_to_float(mse));
+		printf("RMSE: %f\n", fix16_to_float(fix16_sqrt(mse)));
 
+		for (int j = 0; j < 4; j++) {
+			uneural_activate_network(&network,
+						 inputs[j],
+						 &actual_output);
+			printf("Actual output %d - %f \n", j,
+			       fix16_to_float(actual_output));
+		}
 	}
 
 
@@ -1,3 +1,6 @@
+/* This file holds the out-of-line definitions, which are always built
+ * so that code compiled without FIXMATH_INLINE still links */
+#undef FIXMATH_INLINE
 #include "fix16.h"
 #include "int64.h"
 
@@ -6,54 +9,12 @@
  * The versions without overflow detection are inlined in the header.
  */
 #ifndef FIXMATH_NO_OVERFLOW
-fix16_t fix16_add(fix16_t a, fix16_t b)
-{
-	// Use unsigned integers because overflow with signed integers is
-	// an undefined operation (http://www.airs.com/blog/archives/120).
-	uint32_t _a = a, _b = b;
-	uint32_t sum = _a + _b;
-
-	// Overflow can only happen if sign of a == sign of b, and then
-	// it causes sign of sum != sign of a.
-	if (!((_a ^ _b) & 0x80000000) && ((_a ^ sum) & 0x80000000))
-		return fix16_overflow;
-	
-	return sum;
-}
-
-fix16_t fix16_sub(fix16_t a, fix16_t b)
-{
-	uint32_t _a = a, _b = b;
-	uint32_t diff = _a - _b;
-
-	// Overflow can only happen if sign of a != sign of b, and then
-	// it causes sign of diff != sign of a.
-	if (((_a ^ _b) & 0x80000000) && ((_a ^ diff) & 0x80000000))
-		return fix16_overflow;
-	
-	return diff;
-}
+fix16_t fix16_add(fix16_t a, fix16_t b) { return fix16_impl_add(a, b); }
+fix16_t fix16_sub(fix16_t a, fix16_t b) { return fix16_impl_sub(a, b); }
 
 /* Saturating arithmetic */
-fix16_t fix16_sadd(fix16_t a, fix16_t b)
-{
-	fix16_t result = fix16_add(a, b);
-
-	if (result == fix16_overflow)
-		return (a >= 0) ? fix16_maximum : fix16_minimum;
-
-	return result;
-}	
-
-fix16_t fix16_ssub(fix16_t a, fix16_t b)
-{
-	fix16_t result = fix16_sub(a, b);
-
-	if (result == fix16_overflow)
-		return (a >= 0) ? fix16_maximum : fix16_minimum;
-
-	return result;
-}
+fix16_t fix16_sadd(fix16_t a, fix16_t b) { return fix16_impl_sadd(a, b); }
+fix16_t fix16_ssub(fix16_t a, fix16_t b) { return fix16_impl_ssub(a, b); }
 #endif
 
 
@@ -65,44 +26,7 @@ fix16_t fix16_ssub(fix16_t a, fix16_t b)
  */
  
 #if !defined(FIXMATH_NO_64BIT) && !defined(FIXMATH_OPTIMIZE_8BIT)
-fix16_t fix16_mul(fix16_t inArg0, fix16_t inArg1)
-{
-	int64_t product = (int64_t)inArg0 * inArg1;
-	
-	#ifndef FIXMATH_NO_OVERFLOW
-	// The upper 17 bits should all be the same (the sign).
-	uint32_t upper = (product >> 47);
-	#endif
-	
-	if (product < 0)
-	{
-		#ifndef FIXMATH_NO_OVERFLOW
-		if (~upper)
-				return fix16_overflow;
-		#endif
-		
-		#ifndef FIXMATH_NO_ROUNDING
-		// This adjustment is required in order to round -1/2 correctly
-		product--;
-		#endif
-	}
-	else
-	{
-		#ifndef FIXMATH_NO_OVERFLOW
-		if (upper)
-				return fix16_overflow;
-		#endif
-	}
-	
-	#ifdef FIXMATH_NO_ROUNDING
-	return product >> 16;
-	#else
-	fix16_t result = product >> 16;
-	result += (product & 0x8000) >> 15;
-	
-	return result;
-	#endif
-}
+fix16_t fix16_mul(fix16_t inArg0, fix16_t inArg1) { return fix16_impl_mul(inArg0, inArg1); }
 #endif
 
 /* 32-bit implementation of fix16_mul. Potentially fast on 16-bit processors,
@@ -252,20 +176,7 @@ fix16_t fix16_mul(fix16_t inArg0, fix16_t inArg1)
 
 #ifndef FIXMATH_NO_OVERFLOW
 /* Wrapper around fix16_mul to add saturating arithmetic. */
-fix16_t fix16_smul(fix16_t inArg0, fix16_t inArg1)
-{
-	fix16_t result = fix16_mul(inArg0, inArg1);
-	
-	if (result == fix16_overflow)
-	{
-		if ((inArg0 >= 0) == (inArg1 >= 0))
-			return fix16_maximum;
-		else
-			return fix16_minimum;
-	}
-	
-	return result;
-}
+fix16_t fix16_smul(fix16_t inArg0, fix16_t inArg1) { return fix16_impl_smul(inArg0, inArg1); }
 #endif
 
 /* 32-bit implementation of fix16_div. Fastest version for e.g. ARM Cortex M3.
@@ -22,6 +22,7 @@ extern "C"
 #endif
 
 #include <stdint.h>
+#include <stddef.h>
 
 typedef int32_t fix16_t;
 
@@ -99,12 +100,230 @@ static inline fix16_t fix16_max(fix16_t x, fix16_t y)
 static inline fix16_t fix16_clamp(fix16_t x, fix16_t lo, fix16_t hi)
 	{ return fix16_min(fix16_max(x, lo), hi); }
 
+/* Branch free arithmetic on the compiler's overflow builtins, selected
+ * with FIXMATH_BUILTIN_OVERFLOW. Saturation becomes a conditional
+ * select (cmov and friends) and the loops calling these can vectorize.
+ * The results are identical to the portable versions, quirks included:
+ * an exact result of fix16_minimum is indistinguishable from
+ * fix16_overflow and saturates the same way */
+#ifdef FIXMATH_BUILTIN_OVERFLOW
+#ifndef __GNUC__
+# error "FIXMATH_BUILTIN_OVERFLOW needs GCC or clang"
+#endif
+
+/* x if cond is 0, y if it is 1, as a mask blend that compilers keep
+ * free of branches */
+static inline fix16_t fix16_builtin_select(uint32_t cond, fix16_t x, fix16_t y)
+{
+	uint32_t mask = -cond;
+	return ((uint32_t)x & ~mask) | ((uint32_t)y & mask);
+}
+
+#ifndef FIXMATH_NO_OVERFLOW
+static inline fix16_t fix16_builtin_add(fix16_t a, fix16_t b)
+{
+	int32_t sum;
+	uint32_t overflow = __builtin_add_overflow(a, b, &sum);
+	return fix16_builtin_select(overflow, sum, fix16_overflow);
+}
+
+static inline fix16_t fix16_builtin_sub(fix16_t a, fix16_t b)
+{
+	int32_t diff;
+	uint32_t overflow = __builtin_sub_overflow(a, b, &diff);
+	return fix16_builtin_select(overflow, diff, fix16_overflow);
+}
+
+/* fix16_maximum for a non-negative sign, fix16_minimum otherwise */
+static inline fix16_t fix16_builtin_limit(fix16_t sign)
+	{ return (uint32_t)fix16_maximum + ((uint32_t)sign >> 31); }
+
+static inline fix16_t fix16_builtin_sadd(fix16_t a, fix16_t b)
+{
+	int32_t sum;
+	uint32_t overflow = __builtin_add_overflow(a, b, &sum);
+	return fix16_builtin_select(overflow | (sum == fix16_overflow), sum,
+				    fix16_builtin_limit(a));
+}
+
+static inline fix16_t fix16_builtin_ssub(fix16_t a, fix16_t b)
+{
+	int32_t diff;
+	uint32_t overflow = __builtin_sub_overflow(a, b, &diff);
+	return fix16_builtin_select(overflow | (diff == fix16_overflow), diff,
+				    fix16_builtin_limit(a));
+}
+#endif
+
+#if !defined(FIXMATH_NO_64BIT) && !defined(FIXMATH_OPTIMIZE_8BIT)
+static inline fix16_t fix16_builtin_mul(fix16_t inArg0, fix16_t inArg1)
+{
+	int64_t product = (int64_t)inArg0 * inArg1;
+
+	#ifndef FIXMATH_NO_OVERFLOW
+	// The upper 17 bits are all the same (the sign) exactly when the
+	// product shifted down by 16 still fits in 32 bits.
+	int32_t upper;
+	uint32_t overflow = __builtin_add_overflow(product >> 16, 0, &upper);
+	#endif
+
+	#ifdef FIXMATH_NO_ROUNDING
+	uint32_t result = product >> 16;
+	#else
+	// Same -1/2 adjustment as fix16_mul, as a subtraction of the sign.
+	product -= (product < 0);
+	uint32_t result = (uint32_t)(product >> 16) + ((uint32_t)(product >> 15) & 1);
+	#endif
+
+	#ifndef FIXMATH_NO_OVERFLOW
+	return fix16_builtin_select(overflow, result, fix16_overflow);
+	#else
+	return result;
+	#endif
+}
+
+#ifndef FIXMATH_NO_OVERFLOW
+static inline fix16_t fix16_builtin_smul(fix16_t inArg0, fix16_t inArg1)
+{
+	fix16_t result = fix16_builtin_mul(inArg0, inArg1);
+	return fix16_builtin_select(result == fix16_overflow, result,
+				    fix16_builtin_limit(inArg0 ^ inArg1));
+}
+#endif
+#endif
+#endif
+
+/* The bodies of the overflow checked arithmetic. They are inlined from
+ * here with FIXMATH_INLINE, and fix16.c wraps the same bodies as the
+ * out-of-line functions, which are always built */
+#ifndef FIXMATH_NO_OVERFLOW
+static inline fix16_t fix16_impl_add(fix16_t a, fix16_t b)
+{
+	#ifdef FIXMATH_BUILTIN_OVERFLOW
+	return fix16_builtin_add(a, b);
+	#else
+	// Use unsigned integers because overflow with signed integers is
+	// an undefined operation (http://www.airs.com/blog/archives/120).
+	uint32_t _a = a, _b = b;
+	uint32_t sum = _a + _b;
+
+	// Overflow can only happen if sign of a == sign of b, and then
+	// it causes sign of sum != sign of a.
+	if (!((_a ^ _b) & 0x80000000) && ((_a ^ sum) & 0x80000000))
+		return fix16_overflow;
+
+	return sum;
+	#endif
+}
+
+static inline fix16_t fix16_impl_sub(fix16_t a, fix16_t b)
+{
+	#ifdef FIXMATH_BUILTIN_OVERFLOW
+	return fix16_builtin_sub(a, b);
+	#else
+	uint32_t _a = a, _b = b;
+	uint32_t diff = _a - _b;
+
+	// Overflow can only happen if sign of a != sign of b, and then
+	// it causes sign of diff != sign of a.
+	if (((_a ^ _b) & 0x80000000) && ((_a ^ diff) & 0x80000000))
+		return fix16_overflow;
+
+	return diff;
+	#endif
+}
+
+static inline fix16_t fix16_impl_sadd(fix16_t a, fix16_t b)
+{
+	#ifdef FIXMATH_BUILTIN_OVERFLOW
+	return fix16_builtin_sadd(a, b);
+	#else
+	fix16_t result = fix16_impl_add(a, b);
+
+	if (result == fix16_overflow)
+		return (a >= 0) ? fix16_maximum : fix16_minimum;
+
+	return result;
+	#endif
+}
+
+static inline fix16_t fix16_impl_ssub(fix16_t a, fix16_t b)
+{
+	#ifdef FIXMATH_BUILTIN_OVERFLOW
+	return fix16_builtin_ssub(a, b);
+	#else
+	fix16_t result = fix16_impl_sub(a, b);
+
+	if (result == fix16_overflow)
+		return (a >= 0) ? fix16_maximum : fix16_minimum;
+
+	return result;
+	#endif
+}
+#endif
+
+/* Only the 64-bit multiplication is short enough to be worth inlining,
+ * the 32-bit and 8-bit versions live in fix16.c alone */
+#if !defined(FIXMATH_NO_64BIT) && !defined(FIXMATH_OPTIMIZE_8BIT)
+static inline fix16_t fix16_impl_mul(fix16_t inArg0, fix16_t inArg1)
+{
+	#ifdef FIXMATH_BUILTIN_OVERFLOW
+	return fix16_builtin_mul(inArg0, inArg1);
+	#else
+	int64_t product = (int64_t)inArg0 * inArg1;
+
+	#ifndef FIXMATH_NO_OVERFLOW
+	// The upper 17 bits should all be the same (the sign).
+	uint32_t upper = (product >> 47);
+	#endif
+
+	if (product < 0)
+	{
+		#ifndef FIXMATH_NO_OVERFLOW
+		if (~upper)
+			return fix16_overflow;
+		#endif
+
+		#ifndef FIXMATH_NO_ROUNDING
+		// This adjustment is required in order to round -1/2 correctly
+		product--;
+		#endif
+	}
+	else
+	{
+		#ifndef FIXMATH_NO_OVERFLOW
+		if (upper)
+			return fix16_overflow;
+		#endif
+	}
+
+	#ifdef FIXMATH_NO_ROUNDING
+	return product >> 16;
+	#else
+	fix16_t result = product >> 16;
+	result += (product & 0x8000) >> 15;
+
+	return result;
+	#endif
+	#endif
+}
+#endif
+
 /* Subtraction and addition with (optional) overflow detection. */
 #ifdef FIXMATH_NO_OVERFLOW
 
 static inline fix16_t fix16_add(fix16_t inArg0, fix16_t inArg1) { return (inArg0 + inArg1); }
 static inline fix16_t fix16_sub(fix16_t inArg0, fix16_t inArg1) { return (inArg0 - inArg1); }
 
+#elif defined(FIXMATH_INLINE)
+
+static inline fix16_t fix16_add(fix16_t a, fix16_t b) { return fix16_impl_add(a, b); }
+static inline fix16_t fix16_sub(fix16_t a, fix16_t b) { return fix16_impl_sub(a, b); }
+
+/* Saturating arithmetic */
+static inline fix16_t fix16_sadd(fix16_t a, fix16_t b) { return fix16_impl_sadd(a, b); }
+static inline fix16_t fix16_ssub(fix16_t a, fix16_t b) { return fix16_impl_ssub(a, b); }
+
 #else
 
 extern fix16_t fix16_add(fix16_t a, fix16_t b) FIXMATH_FUNC_ATTRS;
@@ -116,18 +335,54 @@ extern fix16_t fix16_ssub(fix16_t a, fix16_t b) FIXMATH_FUNC_ATTRS;
 
 #endif
 
+#if defined(FIXMATH_INLINE) && !defined(FIXMATH_NO_64BIT) && !defined(FIXMATH_OPTIMIZE_8BIT)
+# define FIXMATH_INLINE_MUL
+#endif
+
+#ifdef FIXMATH_INLINE_MUL
+/*! Multiplies the two given fix16_t's and returns the result.
+*/
+static inline fix16_t fix16_mul(fix16_t inArg0, fix16_t inArg1)
+	{ return fix16_impl_mul(inArg0, inArg1); }
+#else
 /*! Multiplies the two given fix16_t's and returns the result.
 */
 extern fix16_t fix16_mul(fix16_t inArg0, fix16_t inArg1) FIXMATH_FUNC_ATTRS;
+#endif
 
 /*! Divides the first given fix16_t by the second and returns the result.
 */
 extern fix16_t fix16_div(fix16_t inArg0, fix16_t inArg1) FIXMATH_FUNC_ATTRS;
 
 #ifndef FIXMATH_NO_OVERFLOW
+/* Wrapper around fix16_mul to add saturating arithmetic. */
+static inline fix16_t fix16_impl_smul(fix16_t inArg0, fix16_t inArg1)
+{
+	#if defined(FIXMATH_BUILTIN_OVERFLOW) && !defined(FIXMATH_NO_64BIT) && !defined(FIXMATH_OPTIMIZE_8BIT)
+	return fix16_builtin_smul(inArg0, inArg1);
+	#else
+	fix16_t result = fix16_mul(inArg0, inArg1);
+
+	if (result == fix16_overflow)
+	{
+		if ((inArg0 >= 0) == (inArg1 >= 0))
+			return fix16_maximum;
+		else
+			return fix16_minimum;
+	}
+
+	return result;
+	#endif
+}
+
 /*! Performs a saturated multiplication (overflow-protected) of the two given fix16_t's and returns the result.
 */
+#ifdef FIXMATH_INLINE_MUL
+static inline fix16_t fix16_smul(fix16_t inArg0, fix16_t inArg1)
+	{ return fix16_impl_smul(inArg0, inArg1); }
+#else
 extern fix16_t fix16_smul(fix16_t inArg0, fix16_t inArg1) FIXMATH_FUNC_ATTRS;
+#endif
 
 /*! Performs a saturated division (overflow-protected) of the first fix16_t by the second and returns the result.
 */
@@ -202,6 +457,8 @@ static inline fix16_t fix16_sq(fix16_t x)
 	{ return fix16_mul(x, x); }
 
 /*! Returns the exponent (e^) of the given fix16_t.
+ * Within one unit of the correctly rounded result (without
+ * FIXMATH_NO_64BIT).
 */
 extern fix16_t fix16_exp(fix16_t inValue) FIXMATH_FUNC_ATTRS;
 
@@ -228,6 +485,48 @@ extern void fix16_to_str(fix16_t value, char *buf, int decimals);
  */
 extern fix16_t fix16_from_str(const char *buf);
 
+/*! Convert at most len characters of buf to a fix16_t value
+ * Skips leading spaces and tabs and stops at the first character that
+ * is not part of the number, storing its position in *end (if end is
+ * not NULL). Only '.' is accepted as the decimal point, so ',' can
+ * delimit fields. On overflow or if there are no digits, returns
+ * fix16_overflow and sets *end to buf.
+ */
+extern fix16_t fix16_from_strn(const char *buf, size_t len, const char **end);
+
+#ifndef FIXMATH_NO_OVERFLOW
+/* Array operations (fix16_vec.c). Every element gives exactly the result
+ * of the scalar saturating function named; on x86 SSE4.1 or AVX2
+ * versions are picked at runtime unless FIXMATH_NO_SIMD is defined.
+ * dst may be the same array as a source, but must not partially overlap
+ * one.
+ */
+
+/*! dst[i] = fix16_sadd(a[i], b[i]) */
+extern void fix16_vec_add(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n);
+/*! dst[i] = fix16_ssub(a[i], b[i]) */
+extern void fix16_vec_sub(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n);
+/*! dst[i] = fix16_smul(a[i], b[i]) */
+extern void fix16_vec_mul(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n);
+/*! dst[i] = fix16_smul(a[i], s) */
+extern void fix16_vec_scale(fix16_t *dst, const fix16_t *a, fix16_t s, size_t n);
+/*! y[i] = fix16_sadd(y[i], fix16_smul(alpha, x[i])) */
+extern void fix16_vec_axpy(fix16_t *y, fix16_t alpha, const fix16_t *x, size_t n);
+/*! dst[i] = fix16_clamp(a[i], lo, hi) */
+extern void fix16_vec_clamp(fix16_t *dst, const fix16_t *a, fix16_t lo, fix16_t hi, size_t n);
+
+/*! Returns acc plus the products a[i] * b[i], saturated exactly as
+ * acc = fix16_sadd(acc, fix16_smul(a[i], b[i])) in order of i would be.
+ */
+extern fix16_t fix16_vec_dot(fix16_t acc, const fix16_t *a, const fix16_t *b, size_t n);
+/*! Returns the sum of a[i], saturated as the fix16_sadd loop would be. */
+extern fix16_t fix16_vec_sum(const fix16_t *a, size_t n);
+/*! Smallest element, fix16_maximum if n is 0. */
+extern fix16_t fix16_vec_min(const fix16_t *a, size_t n);
+/*! Largest element, fix16_minimum if n is 0. */
+extern fix16_t fix16_vec_max(const fix16_t *a, size_t n);
+#endif
+
 /** Helper macro for F16C. Replace token with its number of characters/digits. */
 #define FIXMATH_TOKLEN(token) ( sizeof( #token ) - 1 )
 
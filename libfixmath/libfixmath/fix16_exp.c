@@ -1,25 +1,73 @@
 #include "fix16.h"
 #include <stdbool.h>
 
-#ifndef FIXMATH_NO_CACHE
-static fix16_t _fix16_exp_cache_index[4096]  = { 0 };
-static fix16_t _fix16_exp_cache_value[4096]  = { 0 };
-#endif
+#ifndef FIXMATH_NO_64BIT
+
+/* 2^(j/64) - 1 for j = 0..63, with 32 fractional bits. */
+static const uint32_t _fix16_exp2_table[64] = {
+	0x00000000, 0x02C9A3E7, 0x059B0D31, 0x08745187,
+	0x0B5586D0, 0x0E3EC32D, 0x11301D01, 0x1429AAEB,
+	0x172B83C8, 0x1A35BEB7, 0x1D487317, 0x2063B886,
+	0x2387A6E7, 0x26B4565E, 0x29E9DF52, 0x2D285A6E,
+	0x306FE0A3, 0x33C08B26, 0x371A7374, 0x3A7DB34E,
+	0x3DEA64C1, 0x4160A21F, 0x44E08606, 0x486A2B5C,
+	0x4BFDAD53, 0x4F9B276A, 0x5342B56A, 0x56F4736B,
+	0x5AB07DD5, 0x5E76F15B, 0x6247EB04, 0x66238825,
+	0x6A09E668, 0x6DFB23C6, 0x71F75E8F, 0x75FEB564,
+	0x7A11473F, 0x7E2F336D, 0x82589995, 0x868D99B4,
+	0x8ACE5423, 0x8F1AE991, 0x93737B0D, 0x97D829FE,
+	0x9C49182A, 0xA0C667B6, 0xA5503B24, 0xA9E6B558,
+	0xAE89F996, 0xB33A2B85, 0xB7F76F30, 0xBCC1E905,
+	0xC199BDD8, 0xC67F12E5, 0xCB720DCF, 0xD072D4A0,
+	0xD5818DD0, 0xDA9E603E, 0xDFC97338, 0xE502EE79,
+	0xEA4AFA2A, 0xEFA1BEE6, 0xF50765B7, 0xFA7C181A,
+};
+
+fix16_t fix16_exp(fix16_t inValue)
+{
+	if (inValue == 0) return fix16_one;
+	if (inValue >= 681391) return fix16_maximum;
+	if (inValue <= -772243) return 0;
+
+	/* Range reduction: with n = round(x * 64 / ln 2),
+	 *   e^x = 2^(n / 64) * e^r,  |r| <= ln(2) / 128,
+	 * where 2^(n / 64) is a power of two times an entry of the table
+	 * above and e^r - 1 = r + r^2/2 + r^3/6 to within 2^-34. Both
+	 * factors carry 32 fractional bits, so every result is the
+	 * correctly rounded value or one unit away from it. */
+
+	// 64/ln(2) with 24 fractional bits, ln(2)/64 with 48.
+	int64_t n = ((int64_t)inValue * 1549082005 + ((int64_t)1 << 39)) >> 40;
+	int64_t r = (int64_t)inValue * ((int64_t)1 << 32) - n * 3048493539143;
+	r = (r + 0x8000) >> 16;
+
+	int64_t half_r2 = ((r * r) + ((int64_t)1 << 32)) >> 33;
+	int64_t sixth_r3 = (half_r2 * r) / ((int64_t)3 << 32);
+	int64_t er = r + half_r2 + sixth_r3;
 
+	// 2^(j/64) * e^r = (1 + t)(1 + er) = 1 + t + er + t * er
+	int64_t t = _fix16_exp2_table[(uint32_t)n & 63];
+	int64_t mantissa = ((int64_t)1 << 32) + t + er +
+		((t * er + ((int64_t)1 << 31)) >> 32);
 
+	// Scale by 2^(n >> 6), leaving 16 fractional bits.
+	int shift = 16 - (int)(n >> 6);
+	int64_t result = (mantissa + ((int64_t)1 << (shift - 1))) >> shift;
+
+	if (result > fix16_maximum)
+		return fix16_maximum;
+
+	return result;
+}
+
+#else
 
+/* Without 64-bit arithmetic, sum the power series instead. */
 fix16_t fix16_exp(fix16_t inValue) {
 	if(inValue == 0        ) return fix16_one;
 	if(inValue == fix16_one) return fix16_e;
 	if(inValue >= 681391   ) return fix16_maximum;
 	if(inValue <= -772243  ) return 0;
-
-	#ifndef FIXMATH_NO_CACHE
-	fix16_t tempIndex = (inValue ^ (inValue >> 16));
-	tempIndex = (inValue ^ (inValue >> 4)) & 0x0FFF;
-	if(_fix16_exp_cache_index[tempIndex] == inValue)
-		return _fix16_exp_cache_value[tempIndex];
-	#endif
                         
 	/* The algorithm is based on the power series for exp(x):
 	 * http://en.wikipedia.org/wiki/Exponential_function#Formal_definition
@@ -32,6 +80,17 @@ fix16_t fix16_exp(fix16_t inValue) {
 	// and exp(-x) = 1/exp(x).
 	bool neg = (inValue < 0);
 	if (neg) inValue = -inValue;
+
+	// Past ln(32768) e^x itself overflows, but e^-x = (e^(-x/2))^2.
+	if (neg && (inValue >= 681391))
+	{
+		fix16_t half = fix16_exp(-(inValue >> 1));
+#ifdef FIXMATH_SATURATED_ONLY
+		return fix16_smul(half, half);
+#else
+		return fix16_mul(half, half);
+#endif
+	}
             
 	fix16_t result = inValue + fix16_one;
 	fix16_t term = inValue;
@@ -54,15 +113,12 @@ fix16_t fix16_exp(fix16_t inValue) {
 #else
 	if (neg) result = fix16_div(fix16_one, result);
 #endif
-            
-	#ifndef FIXMATH_NO_CACHE
-	_fix16_exp_cache_index[tempIndex] = inValue;
-	_fix16_exp_cache_value[tempIndex] = result;
-	#endif
 
 	return result;
 }
 
+#endif
+
 
 fix16_t fix16_log(fix16_t inValue)
 {
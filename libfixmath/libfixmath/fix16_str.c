@@ -112,3 +112,65 @@ fix16_t fix16_from_str(const char *buf)
     return negative ? -value : value;
 }
 
+
+fix16_t fix16_from_strn(const char *buf, size_t len, const char **end)
+{
+    const char *p = buf;
+    const char *stop = buf + len;
+    unsigned digit;
+
+    while (p < stop && (*p == ' ' || *p == '\t'))
+        p++;
+
+    /* Decode the sign */
+    bool negative = (p < stop && *p == '-');
+    if (p < stop && (*p == '+' || *p == '-'))
+        p++;
+
+    /* Decode the integer part. The unsigned subtraction folds both
+     * range checks of isdigit() into one compare */
+    uint32_t intpart = 0;
+    int count = 0;
+    while (p < stop && (digit = (unsigned)(*p - '0')) < 10)
+    {
+        intpart = intpart * 10 + digit;
+        p++;
+        count++;
+    }
+
+    if (count == 0 || count > 5
+        || intpart > 32768 || (!negative && intpart > 32767))
+    {
+        if (end)
+            *end = buf;
+        return fix16_overflow;
+    }
+
+    fix16_t value = intpart << 16;
+
+    /* Decode the decimal part, digits past the fifth are consumed but
+     * do not affect the result (as in fix16_from_str) */
+    if (p < stop && *p == '.')
+    {
+        p++;
+
+        uint32_t fracpart = 0;
+        uint32_t scale = 1;
+        while (p < stop && (digit = (unsigned)(*p - '0')) < 10)
+        {
+            if (scale < 100000)
+            {
+                scale *= 10;
+                fracpart = fracpart * 10 + digit;
+            }
+            p++;
+        }
+
+        value += fix16_div(fracpart, scale);
+    }
+
+    if (end)
+        *end = p;
+
+    return negative ? -value : value;
+}
@@ -1,16 +1,36 @@
 #include <limits.h>
 #include "fix16.h"
 
+/* The caches are written on every miss, so a threaded build gives each
+ * thread its own copy: lookups then neither race with nor share cache
+ * lines with other threads. This is selected by building with -pthread
+ * (which defines _REENTRANT) or with FIXMATH_THREAD_LOCAL_CACHE.
+ * FIXMATH_NO_CACHE leaves the caches out, and FIXMATH_SIN_LUT replaces
+ * the sin cache with a read-only table, both of which need no state. */
+#if !defined(FIXMATH_NO_CACHE) && (defined(FIXMATH_THREAD_LOCAL_CACHE) || defined(_REENTRANT))
+# if defined(__GNUC__)
+#  define FIXMATH_CACHE static __thread
+# elif defined(_MSC_VER)
+#  define FIXMATH_CACHE static __declspec(thread)
+# elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#  define FIXMATH_CACHE static _Thread_local
+# else
+#  error "Thread local caches are not supported by this compiler, define FIXMATH_NO_CACHE"
+# endif
+#else
+# define FIXMATH_CACHE static
+#endif
+
 #if defined(FIXMATH_SIN_LUT)
 #include "fix16_trig_sin_lut.h"
 #elif !defined(FIXMATH_NO_CACHE)
-static fix16_t _fix16_sin_cache_index[4096]  = { 0 };
-static fix16_t _fix16_sin_cache_value[4096]  = { 0 };
+FIXMATH_CACHE fix16_t _fix16_sin_cache_index[4096]  = { 0 };
+FIXMATH_CACHE fix16_t _fix16_sin_cache_value[4096]  = { 0 };
 #endif
 
 #ifndef FIXMATH_NO_CACHE
-static fix16_t _fix16_atan_cache_index[2][4096] = { { 0 }, { 0 } };
-static fix16_t _fix16_atan_cache_value[4096] = { 0 };
+FIXMATH_CACHE fix16_t _fix16_atan_cache_index[2][4096] = { { 0 }, { 0 } };
+FIXMATH_CACHE fix16_t _fix16_atan_cache_value[4096] = { 0 };
 #endif
 
 
@@ -2,7 +2,7 @@
 #define __fix16_trig_sin_lut_h__
 
 static const uint32_t _fix16_sin_lut_count = 102688;
-static uint16_t _fix16_sin_lut[102688] = {
+static const uint16_t _fix16_sin_lut[102688] = {
 	0, 1, 2, 3, 4, 5, 6, 7, 
 	8, 9, 10, 11, 12, 13, 14, 15, 
 	16, 17, 18, 19, 20, 21, 22, 23, 
@@ -0,0 +1,830 @@
+#include "fix16.h"
+
+#ifndef FIXMATH_NO_OVERFLOW
+
+/* The vector versions reproduce the default configuration (64-bit
+ * multiply, rounding, overflow detection). Any other configuration only
+ * gets the scalar loops. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+	!defined(FIXMATH_NO_SIMD) && !defined(FIXMATH_NO_64BIT) && \
+	!defined(FIXMATH_NO_ROUNDING) && !defined(FIXMATH_OPTIMIZE_8BIT)
+#define FIXMATH_VEC_X86
+#include <immintrin.h>
+#endif
+
+static void fix16_vec_add_scalar(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = fix16_sadd(a[i], b[i]);
+}
+
+static void fix16_vec_sub_scalar(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = fix16_ssub(a[i], b[i]);
+}
+
+static void fix16_vec_mul_scalar(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = fix16_smul(a[i], b[i]);
+}
+
+static void fix16_vec_scale_scalar(fix16_t *dst, const fix16_t *a,
+	fix16_t s, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = fix16_smul(a[i], s);
+}
+
+static void fix16_vec_axpy_scalar(fix16_t *y, fix16_t alpha,
+	const fix16_t *x, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		y[i] = fix16_sadd(y[i], fix16_smul(alpha, x[i]));
+}
+
+static void fix16_vec_clamp_scalar(fix16_t *dst, const fix16_t *a,
+	fix16_t lo, fix16_t hi, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		dst[i] = fix16_clamp(a[i], lo, hi);
+}
+
+static fix16_t fix16_vec_dot_scalar(fix16_t acc, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc = fix16_sadd(acc, fix16_smul(a[i], b[i]));
+	return acc;
+}
+
+static fix16_t fix16_vec_sum_scalar(fix16_t acc, const fix16_t *a, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc = fix16_sadd(acc, a[i]);
+	return acc;
+}
+
+static fix16_t fix16_vec_min_scalar(fix16_t acc, const fix16_t *a, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc = fix16_min(acc, a[i]);
+	return acc;
+}
+
+static fix16_t fix16_vec_max_scalar(fix16_t acc, const fix16_t *a, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		acc = fix16_max(acc, a[i]);
+	return acc;
+}
+
+#ifdef FIXMATH_VEC_X86
+
+/* Saturating sums are order dependent, so the vector dot product and sum
+ * add up exact 64-bit values and their magnitudes instead. If the
+ * magnitudes (and the starting value) fit in a fix16_t, no term and no
+ * partial sum can have saturated and the exact sum is what the scalar
+ * loop gives; otherwise the block is rerun through the scalar loop. The
+ * blocks keep the 64-bit totals far from overflowing. */
+static const size_t fix16_vec_block = 4096;
+
+static inline int64_t fix16_vec_abs64(int64_t x)
+	{ return (x < 0 ? -x : x); }
+
+typedef struct
+{
+	void (*add)(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n);
+	void (*sub)(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n);
+	void (*mul)(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n);
+	void (*scale)(fix16_t *dst, const fix16_t *a, fix16_t s, size_t n);
+	void (*axpy)(fix16_t *y, fix16_t alpha, const fix16_t *x, size_t n);
+	void (*clamp)(fix16_t *dst, const fix16_t *a, fix16_t lo, fix16_t hi,
+		size_t n);
+	fix16_t (*dot)(fix16_t acc, const fix16_t *a, const fix16_t *b,
+		size_t n);
+	fix16_t (*sum)(fix16_t acc, const fix16_t *a, size_t n);
+	fix16_t (*min)(fix16_t acc, const fix16_t *a, size_t n);
+	fix16_t (*max)(fix16_t acc, const fix16_t *a, size_t n);
+} fix16_vec_kernels_t;
+
+/* SSE4.1, four lanes. */
+
+/* fix16_maximum in lanes where sign is non-negative, fix16_minimum
+ * elsewhere. */
+__attribute__((target("sse4.1")))
+static inline __m128i fix16_vec_limit_sse(__m128i sign)
+{
+	return _mm_xor_si128(_mm_srai_epi32(sign, 31),
+		_mm_set1_epi32(fix16_maximum));
+}
+
+/* SSE has no 64-bit arithmetic shift or compare, but the high dword of
+ * each lane carries its sign. */
+__attribute__((target("sse4.1")))
+static inline __m128i fix16_vec_sign64_sse(__m128i v)
+{
+	return _mm_shuffle_epi32(_mm_srai_epi32(v, 31), _MM_SHUFFLE(3, 3, 1, 1));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i fix16_vec_sadd_sse(__m128i a, __m128i b)
+{
+	__m128i sum = _mm_add_epi32(a, b);
+	__m128i sat = _mm_and_si128(_mm_xor_si128(a, sum), _mm_xor_si128(b, sum));
+
+	// An exact fix16_overflow saturates as well, like fix16_sadd.
+	sat = _mm_or_si128(_mm_srai_epi32(sat, 31),
+		_mm_cmpeq_epi32(sum, _mm_set1_epi32(fix16_overflow)));
+	return _mm_blendv_epi8(sum, fix16_vec_limit_sse(a), sat);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i fix16_vec_ssub_sse(__m128i a, __m128i b)
+{
+	__m128i diff = _mm_sub_epi32(a, b);
+	__m128i sat = _mm_and_si128(_mm_xor_si128(a, b), _mm_xor_si128(a, diff));
+
+	sat = _mm_or_si128(_mm_srai_epi32(sat, 31),
+		_mm_cmpeq_epi32(diff, _mm_set1_epi32(fix16_overflow)));
+	return _mm_blendv_epi8(diff, fix16_vec_limit_sse(a), sat);
+}
+
+/* Rounds two 64-bit products as fix16_mul does, leaving the results in
+ * the low dwords, and sets *ok in the lanes that did not overflow. */
+__attribute__((target("sse4.1")))
+static inline __m128i fix16_vec_round_sse(__m128i product, __m128i *ok)
+{
+	const __m128i bias = _mm_set1_epi64x((int64_t)1 << 47);
+	const __m128i one = _mm_set1_epi64x(1);
+
+	// In range exactly when product + 2^47 fits in 48 unsigned bits.
+	*ok = _mm_cmpeq_epi64(_mm_srli_epi64(_mm_add_epi64(product, bias), 48),
+		_mm_setzero_si128());
+
+	product = _mm_add_epi64(product, fix16_vec_sign64_sse(product));
+	return _mm_add_epi64(_mm_srli_epi64(product, 16),
+		_mm_and_si128(_mm_srli_epi64(product, 15), one));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i fix16_vec_smul_sse(__m128i a, __m128i b)
+{
+	__m128i ok_even, ok_odd;
+	__m128i even = fix16_vec_round_sse(_mm_mul_epi32(a, b), &ok_even);
+	__m128i odd = fix16_vec_round_sse(_mm_mul_epi32(_mm_srli_epi64(a, 32),
+		_mm_srli_epi64(b, 32)), &ok_odd);
+	__m128i result = _mm_blend_epi16(even, _mm_slli_epi64(odd, 32), 0xCC);
+	__m128i ok = _mm_blend_epi16(ok_even, ok_odd, 0xCC);
+
+	ok = _mm_andnot_si128(_mm_cmpeq_epi32(result,
+		_mm_set1_epi32(fix16_overflow)), ok);
+	return _mm_blendv_epi8(fix16_vec_limit_sse(_mm_xor_si128(a, b)), result, ok);
+}
+
+/* Adds the rounded products of two lanes to *sum and their magnitudes
+ * to *magnitude. */
+__attribute__((target("sse4.1")))
+static inline void fix16_vec_accumulate_sse(__m128i product, __m128i *sum,
+	__m128i *magnitude)
+{
+	__m128i ok;
+	__m128i r = fix16_vec_round_sse(product, &ok);
+
+	// Every rounded product fits in 48 bits, so sign extend from there.
+	r = _mm_sub_epi64(_mm_xor_si128(_mm_and_si128(r,
+		_mm_set1_epi64x(0xFFFFFFFFFFFF)), _mm_set1_epi64x((int64_t)1 << 47)),
+		_mm_set1_epi64x((int64_t)1 << 47));
+
+	__m128i sign = fix16_vec_sign64_sse(r);
+
+	*sum = _mm_add_epi64(*sum, r);
+	*magnitude = _mm_add_epi64(*magnitude,
+		_mm_sub_epi64(_mm_xor_si128(r, sign), sign));
+}
+
+__attribute__((target("sse4.1")))
+static void fix16_vec_add_sse41(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+		__m128i y = _mm_loadu_si128((const __m128i *)&b[i]);
+
+		_mm_storeu_si128((__m128i *)&dst[i], fix16_vec_sadd_sse(x, y));
+	}
+
+	fix16_vec_add_scalar(&dst[i], &a[i], &b[i], n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void fix16_vec_sub_sse41(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+		__m128i y = _mm_loadu_si128((const __m128i *)&b[i]);
+
+		_mm_storeu_si128((__m128i *)&dst[i], fix16_vec_ssub_sse(x, y));
+	}
+
+	fix16_vec_sub_scalar(&dst[i], &a[i], &b[i], n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void fix16_vec_mul_sse41(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+		__m128i y = _mm_loadu_si128((const __m128i *)&b[i]);
+
+		_mm_storeu_si128((__m128i *)&dst[i], fix16_vec_smul_sse(x, y));
+	}
+
+	fix16_vec_mul_scalar(&dst[i], &a[i], &b[i], n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void fix16_vec_scale_sse41(fix16_t *dst, const fix16_t *a,
+	fix16_t s, size_t n)
+{
+	__m128i y = _mm_set1_epi32(s);
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+
+		_mm_storeu_si128((__m128i *)&dst[i], fix16_vec_smul_sse(x, y));
+	}
+
+	fix16_vec_scale_scalar(&dst[i], &a[i], s, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void fix16_vec_axpy_sse41(fix16_t *y, fix16_t alpha,
+	const fix16_t *x, size_t n)
+{
+	__m128i a = _mm_set1_epi32(alpha);
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i u = _mm_loadu_si128((const __m128i *)&x[i]);
+		__m128i v = _mm_loadu_si128((const __m128i *)&y[i]);
+
+		v = fix16_vec_sadd_sse(v, fix16_vec_smul_sse(a, u));
+		_mm_storeu_si128((__m128i *)&y[i], v);
+	}
+
+	fix16_vec_axpy_scalar(&y[i], alpha, &x[i], n - i);
+}
+
+__attribute__((target("sse4.1")))
+static void fix16_vec_clamp_sse41(fix16_t *dst, const fix16_t *a,
+	fix16_t lo, fix16_t hi, size_t n)
+{
+	__m128i l = _mm_set1_epi32(lo);
+	__m128i h = _mm_set1_epi32(hi);
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+
+		x = _mm_min_epi32(_mm_max_epi32(x, l), h);
+		_mm_storeu_si128((__m128i *)&dst[i], x);
+	}
+
+	fix16_vec_clamp_scalar(&dst[i], &a[i], lo, hi, n - i);
+}
+
+__attribute__((target("sse4.1")))
+static fix16_t fix16_vec_dot_sse41(fix16_t acc, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	while (n >= 4)
+	{
+		size_t count = (n < fix16_vec_block ? n : fix16_vec_block) & ~(size_t)3;
+		__m128i sum = _mm_setzero_si128();
+		__m128i magnitude = _mm_setzero_si128();
+		int64_t lanes[2], total, bound;
+
+		for (size_t i = 0; i < count; i += 4)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+			__m128i y = _mm_loadu_si128((const __m128i *)&b[i]);
+
+			fix16_vec_accumulate_sse(_mm_mul_epi32(x, y), &sum, &magnitude);
+			fix16_vec_accumulate_sse(_mm_mul_epi32(_mm_srli_epi64(x, 32),
+				_mm_srli_epi64(y, 32)), &sum, &magnitude);
+		}
+
+		_mm_storeu_si128((__m128i *)lanes, sum);
+		total = lanes[0] + lanes[1];
+		_mm_storeu_si128((__m128i *)lanes, magnitude);
+		bound = lanes[0] + lanes[1] + fix16_vec_abs64(acc);
+
+		if (bound <= fix16_maximum)
+			acc += total;
+		else
+			acc = fix16_vec_dot_scalar(acc, a, b, count);
+
+		a += count;
+		b += count;
+		n -= count;
+	}
+
+	return fix16_vec_dot_scalar(acc, a, b, n);
+}
+
+__attribute__((target("sse4.1")))
+static fix16_t fix16_vec_sum_sse41(fix16_t acc, const fix16_t *a, size_t n)
+{
+	while (n >= 4)
+	{
+		size_t count = (n < fix16_vec_block ? n : fix16_vec_block) & ~(size_t)3;
+		__m128i sum = _mm_setzero_si128();
+		__m128i magnitude = _mm_setzero_si128();
+		int64_t lanes[2], total, bound;
+
+		for (size_t i = 0; i < count; i += 4)
+		{
+			__m128i x = _mm_loadu_si128((const __m128i *)&a[i]);
+			__m128i m = _mm_abs_epi32(x);
+
+			sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(x));
+			sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(_mm_srli_si128(x, 8)));
+			// The magnitude of fix16_minimum only fits unsigned.
+			magnitude = _mm_add_epi64(magnitude, _mm_cvtepu32_epi64(m));
+			magnitude = _mm_add_epi64(magnitude,
+				_mm_cvtepu32_epi64(_mm_srli_si128(m, 8)));
+		}
+
+		_mm_storeu_si128((__m128i *)lanes, sum);
+		total = lanes[0] + lanes[1];
+		_mm_storeu_si128((__m128i *)lanes, magnitude);
+		bound = lanes[0] + lanes[1] + fix16_vec_abs64(acc);
+
+		if (bound <= fix16_maximum)
+			acc += total;
+		else
+			acc = fix16_vec_sum_scalar(acc, a, count);
+
+		a += count;
+		n -= count;
+	}
+
+	return fix16_vec_sum_scalar(acc, a, n);
+}
+
+__attribute__((target("sse4.1")))
+static fix16_t fix16_vec_min_sse41(fix16_t acc, const fix16_t *a, size_t n)
+{
+	__m128i m = _mm_set1_epi32(acc);
+	fix16_t lanes[4];
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+		m = _mm_min_epi32(m, _mm_loadu_si128((const __m128i *)&a[i]));
+
+	_mm_storeu_si128((__m128i *)lanes, m);
+	acc = fix16_vec_min_scalar(acc, lanes, 4);
+	return fix16_vec_min_scalar(acc, &a[i], n - i);
+}
+
+__attribute__((target("sse4.1")))
+static fix16_t fix16_vec_max_sse41(fix16_t acc, const fix16_t *a, size_t n)
+{
+	__m128i m = _mm_set1_epi32(acc);
+	fix16_t lanes[4];
+	size_t i;
+
+	for (i = 0; i + 4 <= n; i += 4)
+		m = _mm_max_epi32(m, _mm_loadu_si128((const __m128i *)&a[i]));
+
+	_mm_storeu_si128((__m128i *)lanes, m);
+	acc = fix16_vec_max_scalar(acc, lanes, 4);
+	return fix16_vec_max_scalar(acc, &a[i], n - i);
+}
+
+/* AVX2, eight lanes. The same as above, lane for lane. */
+
+__attribute__((target("avx2")))
+static inline __m256i fix16_vec_limit_avx2(__m256i sign)
+{
+	return _mm256_xor_si256(_mm256_srai_epi32(sign, 31),
+		_mm256_set1_epi32(fix16_maximum));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fix16_vec_sign64_avx2(__m256i v)
+{
+	return _mm256_shuffle_epi32(_mm256_srai_epi32(v, 31),
+		_MM_SHUFFLE(3, 3, 1, 1));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fix16_vec_sadd_avx2(__m256i a, __m256i b)
+{
+	__m256i sum = _mm256_add_epi32(a, b);
+	__m256i sat = _mm256_and_si256(_mm256_xor_si256(a, sum),
+		_mm256_xor_si256(b, sum));
+
+	sat = _mm256_or_si256(_mm256_srai_epi32(sat, 31),
+		_mm256_cmpeq_epi32(sum, _mm256_set1_epi32(fix16_overflow)));
+	return _mm256_blendv_epi8(sum, fix16_vec_limit_avx2(a), sat);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fix16_vec_ssub_avx2(__m256i a, __m256i b)
+{
+	__m256i diff = _mm256_sub_epi32(a, b);
+	__m256i sat = _mm256_and_si256(_mm256_xor_si256(a, b),
+		_mm256_xor_si256(a, diff));
+
+	sat = _mm256_or_si256(_mm256_srai_epi32(sat, 31),
+		_mm256_cmpeq_epi32(diff, _mm256_set1_epi32(fix16_overflow)));
+	return _mm256_blendv_epi8(diff, fix16_vec_limit_avx2(a), sat);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fix16_vec_round_avx2(__m256i product, __m256i *ok)
+{
+	const __m256i bias = _mm256_set1_epi64x((int64_t)1 << 47);
+	const __m256i one = _mm256_set1_epi64x(1);
+
+	*ok = _mm256_cmpeq_epi64(_mm256_srli_epi64(_mm256_add_epi64(product,
+		bias), 48), _mm256_setzero_si256());
+
+	product = _mm256_add_epi64(product, fix16_vec_sign64_avx2(product));
+	return _mm256_add_epi64(_mm256_srli_epi64(product, 16),
+		_mm256_and_si256(_mm256_srli_epi64(product, 15), one));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i fix16_vec_smul_avx2(__m256i a, __m256i b)
+{
+	__m256i ok_even, ok_odd;
+	__m256i even = fix16_vec_round_avx2(_mm256_mul_epi32(a, b), &ok_even);
+	__m256i odd = fix16_vec_round_avx2(_mm256_mul_epi32(
+		_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32)), &ok_odd);
+	__m256i result = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+	__m256i ok = _mm256_blend_epi32(ok_even, ok_odd, 0xAA);
+
+	ok = _mm256_andnot_si256(_mm256_cmpeq_epi32(result,
+		_mm256_set1_epi32(fix16_overflow)), ok);
+	return _mm256_blendv_epi8(fix16_vec_limit_avx2(_mm256_xor_si256(a, b)),
+		result, ok);
+}
+
+__attribute__((target("avx2")))
+static inline void fix16_vec_accumulate_avx2(__m256i product, __m256i *sum,
+	__m256i *magnitude)
+{
+	__m256i ok;
+	__m256i r = fix16_vec_round_avx2(product, &ok);
+
+	r = _mm256_sub_epi64(_mm256_xor_si256(_mm256_and_si256(r,
+		_mm256_set1_epi64x(0xFFFFFFFFFFFF)),
+		_mm256_set1_epi64x((int64_t)1 << 47)),
+		_mm256_set1_epi64x((int64_t)1 << 47));
+
+	__m256i sign = fix16_vec_sign64_avx2(r);
+
+	*sum = _mm256_add_epi64(*sum, r);
+	*magnitude = _mm256_add_epi64(*magnitude,
+		_mm256_sub_epi64(_mm256_xor_si256(r, sign), sign));
+}
+
+__attribute__((target("avx2")))
+static void fix16_vec_add_avx2(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+		__m256i y = _mm256_loadu_si256((const __m256i *)&b[i]);
+
+		_mm256_storeu_si256((__m256i *)&dst[i], fix16_vec_sadd_avx2(x, y));
+	}
+
+	fix16_vec_add_scalar(&dst[i], &a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void fix16_vec_sub_avx2(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+		__m256i y = _mm256_loadu_si256((const __m256i *)&b[i]);
+
+		_mm256_storeu_si256((__m256i *)&dst[i], fix16_vec_ssub_avx2(x, y));
+	}
+
+	fix16_vec_sub_scalar(&dst[i], &a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void fix16_vec_mul_avx2(fix16_t *dst, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+		__m256i y = _mm256_loadu_si256((const __m256i *)&b[i]);
+
+		_mm256_storeu_si256((__m256i *)&dst[i], fix16_vec_smul_avx2(x, y));
+	}
+
+	fix16_vec_mul_scalar(&dst[i], &a[i], &b[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void fix16_vec_scale_avx2(fix16_t *dst, const fix16_t *a,
+	fix16_t s, size_t n)
+{
+	__m256i y = _mm256_set1_epi32(s);
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+
+		_mm256_storeu_si256((__m256i *)&dst[i], fix16_vec_smul_avx2(x, y));
+	}
+
+	fix16_vec_scale_scalar(&dst[i], &a[i], s, n - i);
+}
+
+__attribute__((target("avx2")))
+static void fix16_vec_axpy_avx2(fix16_t *y, fix16_t alpha,
+	const fix16_t *x, size_t n)
+{
+	__m256i a = _mm256_set1_epi32(alpha);
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256i u = _mm256_loadu_si256((const __m256i *)&x[i]);
+		__m256i v = _mm256_loadu_si256((const __m256i *)&y[i]);
+
+		v = fix16_vec_sadd_avx2(v, fix16_vec_smul_avx2(a, u));
+		_mm256_storeu_si256((__m256i *)&y[i], v);
+	}
+
+	fix16_vec_axpy_scalar(&y[i], alpha, &x[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static void fix16_vec_clamp_avx2(fix16_t *dst, const fix16_t *a,
+	fix16_t lo, fix16_t hi, size_t n)
+{
+	__m256i l = _mm256_set1_epi32(lo);
+	__m256i h = _mm256_set1_epi32(hi);
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+	{
+		__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+
+		x = _mm256_min_epi32(_mm256_max_epi32(x, l), h);
+		_mm256_storeu_si256((__m256i *)&dst[i], x);
+	}
+
+	fix16_vec_clamp_scalar(&dst[i], &a[i], lo, hi, n - i);
+}
+
+__attribute__((target("avx2")))
+static fix16_t fix16_vec_dot_avx2(fix16_t acc, const fix16_t *a,
+	const fix16_t *b, size_t n)
+{
+	while (n >= 8)
+	{
+		size_t count = (n < fix16_vec_block ? n : fix16_vec_block) & ~(size_t)7;
+		__m256i sum = _mm256_setzero_si256();
+		__m256i magnitude = _mm256_setzero_si256();
+		int64_t lanes[4], total, bound;
+
+		for (size_t i = 0; i < count; i += 8)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+			__m256i y = _mm256_loadu_si256((const __m256i *)&b[i]);
+
+			fix16_vec_accumulate_avx2(_mm256_mul_epi32(x, y), &sum,
+				&magnitude);
+			fix16_vec_accumulate_avx2(_mm256_mul_epi32(
+				_mm256_srli_epi64(x, 32), _mm256_srli_epi64(y, 32)),
+				&sum, &magnitude);
+		}
+
+		_mm256_storeu_si256((__m256i *)lanes, sum);
+		total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		_mm256_storeu_si256((__m256i *)lanes, magnitude);
+		bound = lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+			fix16_vec_abs64(acc);
+
+		if (bound <= fix16_maximum)
+			acc += total;
+		else
+			acc = fix16_vec_dot_scalar(acc, a, b, count);
+
+		a += count;
+		b += count;
+		n -= count;
+	}
+
+	return fix16_vec_dot_scalar(acc, a, b, n);
+}
+
+__attribute__((target("avx2")))
+static fix16_t fix16_vec_sum_avx2(fix16_t acc, const fix16_t *a, size_t n)
+{
+	while (n >= 8)
+	{
+		size_t count = (n < fix16_vec_block ? n : fix16_vec_block) & ~(size_t)7;
+		__m256i sum = _mm256_setzero_si256();
+		__m256i magnitude = _mm256_setzero_si256();
+		int64_t lanes[4], total, bound;
+
+		for (size_t i = 0; i < count; i += 8)
+		{
+			__m256i x = _mm256_loadu_si256((const __m256i *)&a[i]);
+			__m256i m = _mm256_abs_epi32(x);
+
+			sum = _mm256_add_epi64(sum,
+				_mm256_cvtepi32_epi64(_mm256_castsi256_si128(x)));
+			sum = _mm256_add_epi64(sum,
+				_mm256_cvtepi32_epi64(_mm256_extracti128_si256(x, 1)));
+			magnitude = _mm256_add_epi64(magnitude,
+				_mm256_cvtepu32_epi64(_mm256_castsi256_si128(m)));
+			magnitude = _mm256_add_epi64(magnitude,
+				_mm256_cvtepu32_epi64(_mm256_extracti128_si256(m, 1)));
+		}
+
+		_mm256_storeu_si256((__m256i *)lanes, sum);
+		total = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		_mm256_storeu_si256((__m256i *)lanes, magnitude);
+		bound = lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+			fix16_vec_abs64(acc);
+
+		if (bound <= fix16_maximum)
+			acc += total;
+		else
+			acc = fix16_vec_sum_scalar(acc, a, count);
+
+		a += count;
+		n -= count;
+	}
+
+	return fix16_vec_sum_scalar(acc, a, n);
+}
+
+__attribute__((target("avx2")))
+static fix16_t fix16_vec_min_avx2(fix16_t acc, const fix16_t *a, size_t n)
+{
+	__m256i m = _mm256_set1_epi32(acc);
+	fix16_t lanes[8];
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+		m = _mm256_min_epi32(m, _mm256_loadu_si256((const __m256i *)&a[i]));
+
+	_mm256_storeu_si256((__m256i *)lanes, m);
+	acc = fix16_vec_min_scalar(acc, lanes, 8);
+	return fix16_vec_min_scalar(acc, &a[i], n - i);
+}
+
+__attribute__((target("avx2")))
+static fix16_t fix16_vec_max_avx2(fix16_t acc, const fix16_t *a, size_t n)
+{
+	__m256i m = _mm256_set1_epi32(acc);
+	fix16_t lanes[8];
+	size_t i;
+
+	for (i = 0; i + 8 <= n; i += 8)
+		m = _mm256_max_epi32(m, _mm256_loadu_si256((const __m256i *)&a[i]));
+
+	_mm256_storeu_si256((__m256i *)lanes, m);
+	acc = fix16_vec_max_scalar(acc, lanes, 8);
+	return fix16_vec_max_scalar(acc, &a[i], n - i);
+}
+
+static const fix16_vec_kernels_t fix16_vec_kernels_scalar =
+{
+	fix16_vec_add_scalar, fix16_vec_sub_scalar, fix16_vec_mul_scalar,
+	fix16_vec_scale_scalar, fix16_vec_axpy_scalar, fix16_vec_clamp_scalar,
+	fix16_vec_dot_scalar, fix16_vec_sum_scalar,
+	fix16_vec_min_scalar, fix16_vec_max_scalar,
+};
+
+static const fix16_vec_kernels_t fix16_vec_kernels_sse41 =
+{
+	fix16_vec_add_sse41, fix16_vec_sub_sse41, fix16_vec_mul_sse41,
+	fix16_vec_scale_sse41, fix16_vec_axpy_sse41, fix16_vec_clamp_sse41,
+	fix16_vec_dot_sse41, fix16_vec_sum_sse41,
+	fix16_vec_min_sse41, fix16_vec_max_sse41,
+};
+
+static const fix16_vec_kernels_t fix16_vec_kernels_avx2 =
+{
+	fix16_vec_add_avx2, fix16_vec_sub_avx2, fix16_vec_mul_avx2,
+	fix16_vec_scale_avx2, fix16_vec_axpy_avx2, fix16_vec_clamp_avx2,
+	fix16_vec_dot_avx2, fix16_vec_sum_avx2,
+	fix16_vec_min_avx2, fix16_vec_max_avx2,
+};
+
+static const fix16_vec_kernels_t *fix16_vec_selected = NULL;
+
+/* Picks the widest kernels the CPU supports on first use. Racing threads
+ * all store the same pointer, so no locking is needed. */
+static const fix16_vec_kernels_t *fix16_vec_kernels(void)
+{
+	const fix16_vec_kernels_t *k;
+
+	k = __atomic_load_n(&fix16_vec_selected, __ATOMIC_RELAXED);
+	if (k != NULL)
+		return k;
+
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2"))
+		k = &fix16_vec_kernels_avx2;
+	else if (__builtin_cpu_supports("sse4.1"))
+		k = &fix16_vec_kernels_sse41;
+	else
+		k = &fix16_vec_kernels_scalar;
+
+	__atomic_store_n(&fix16_vec_selected, k, __ATOMIC_RELAXED);
+	return k;
+}
+
+void fix16_vec_add(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n)
+	{ fix16_vec_kernels()->add(dst, a, b, n); }
+void fix16_vec_sub(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n)
+	{ fix16_vec_kernels()->sub(dst, a, b, n); }
+void fix16_vec_mul(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n)
+	{ fix16_vec_kernels()->mul(dst, a, b, n); }
+void fix16_vec_scale(fix16_t *dst, const fix16_t *a, fix16_t s, size_t n)
+	{ fix16_vec_kernels()->scale(dst, a, s, n); }
+void fix16_vec_axpy(fix16_t *y, fix16_t alpha, const fix16_t *x, size_t n)
+	{ fix16_vec_kernels()->axpy(y, alpha, x, n); }
+void fix16_vec_clamp(fix16_t *dst, const fix16_t *a, fix16_t lo, fix16_t hi, size_t n)
+	{ fix16_vec_kernels()->clamp(dst, a, lo, hi, n); }
+fix16_t fix16_vec_dot(fix16_t acc, const fix16_t *a, const fix16_t *b, size_t n)
+	{ return fix16_vec_kernels()->dot(acc, a, b, n); }
+fix16_t fix16_vec_sum(const fix16_t *a, size_t n)
+	{ return fix16_vec_kernels()->sum(0, a, n); }
+fix16_t fix16_vec_min(const fix16_t *a, size_t n)
+	{ return fix16_vec_kernels()->min(fix16_maximum, a, n); }
+fix16_t fix16_vec_max(const fix16_t *a, size_t n)
+	{ return fix16_vec_kernels()->max(fix16_minimum, a, n); }
+
+#else
+
+void fix16_vec_add(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n)
+	{ fix16_vec_add_scalar(dst, a, b, n); }
+void fix16_vec_sub(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n)
+	{ fix16_vec_sub_scalar(dst, a, b, n); }
+void fix16_vec_mul(fix16_t *dst, const fix16_t *a, const fix16_t *b, size_t n)
+	{ fix16_vec_mul_scalar(dst, a, b, n); }
+void fix16_vec_scale(fix16_t *dst, const fix16_t *a, fix16_t s, size_t n)
+	{ fix16_vec_scale_scalar(dst, a, s, n); }
+void fix16_vec_axpy(fix16_t *y, fix16_t alpha, const fix16_t *x, size_t n)
+	{ fix16_vec_axpy_scalar(y, alpha, x, n); }
+void fix16_vec_clamp(fix16_t *dst, const fix16_t *a, fix16_t lo, fix16_t hi, size_t n)
+	{ fix16_vec_clamp_scalar(dst, a, lo, hi, n); }
+fix16_t fix16_vec_dot(fix16_t acc, const fix16_t *a, const fix16_t *b, size_t n)
+	{ return fix16_vec_dot_scalar(acc, a, b, n); }
+fix16_t fix16_vec_sum(const fix16_t *a, size_t n)
+	{ return fix16_vec_sum_scalar(0, a, n); }
+fix16_t fix16_vec_min(const fix16_t *a, size_t n)
+	{ return fix16_vec_min_scalar(fix16_maximum, a, n); }
+fix16_t fix16_vec_max(const fix16_t *a, size_t n)
+	{ return fix16_vec_max_scalar(fix16_minimum, a, n); }
+
+#endif
+
+#endif
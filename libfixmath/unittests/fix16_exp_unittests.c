@@ -86,6 +86,54 @@ int main()
         TEST(max_delta < 1);
     }
     
+    {
+        COMMENT("Testing fix16_exp() against the rounded result, every input");
+        
+        fix16_t max_delta = -1;
+        fix16_t worst = 0;
+        fix16_t a;
+        
+        for (a = -772243; a < 681391; a++)
+        {
+            fix16_t result = fix16_exp(a);
+            fix16_t resultf = fix16_from_dbl(exp(fix16_to_dbl(a)));
+            
+            fix16_t d = delta(result, resultf);
+            if (d > max_delta)
+            {
+                max_delta = d;
+                worst = a;
+            }
+        }
+        
+        printf("Worst delta %d with input %d\n", max_delta, worst);
+        
+        TEST(max_delta <= 1);
+        TEST(fix16_exp(fix16_one) == fix16_e);
+        TEST(fix16_exp(681390) == fix16_from_dbl(exp(681390 / 65536.0)));
+    }
+    
+    {
+        COMMENT("Testing fix16_exp() where e^-x would overflow");
+        
+        fix16_t max_delta = -1;
+        fix16_t a;
+        
+        for (a = -772243; a <= -681391; a += 7)
+        {
+            fix16_t result = fix16_exp(a);
+            fix16_t resultf = fix16_from_dbl(exp(fix16_to_dbl(a)));
+            
+            fix16_t d = delta(result, resultf);
+            if (d > max_delta)
+                max_delta = d;
+        }
+        
+        printf("Worst delta %d\n", max_delta);
+        
+        TEST(max_delta <= 1);
+    }
+    
     {
         COMMENT("Testing fix16_log() accuracy over full range");
         
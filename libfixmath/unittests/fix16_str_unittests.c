@@ -71,6 +71,29 @@ int main()
         TEST(fix16_from_str("-32768.00000") == fix16_minimum);
     }
     
+    {
+        COMMENT("Testing fix16_from_strn corner cases");
+        const char *end;
+        const char *row = "  -1234.5678,0.5\n";
+
+        TEST(fix16_from_strn(row, strlen(row), &end) == fix16_from_dbl(-1234.5678));
+        TEST(end == row + 12 && *end == ',');
+        TEST(fix16_from_strn(end + 1, strlen(end + 1), &end) == fix16_one / 2);
+        TEST(*end == '\n');
+
+        TEST(fix16_from_strn("1234.5678", 4, &end) == fix16_from_dbl(1234));
+        TEST(fix16_from_strn("1.0000000000", 12, NULL) == fix16_one);
+        TEST(fix16_from_strn("+0.00002", 8, NULL) == 1);
+        TEST(fix16_from_strn("32767.99998", 11, NULL) == fix16_maximum);
+        TEST(fix16_from_strn("-32768.00000", 12, NULL) == fix16_minimum);
+
+        row = "32768";
+        TEST(fix16_from_strn(row, 5, &end) == fix16_overflow && end == row);
+        row = " ,1";
+        TEST(fix16_from_strn(row, 3, &end) == fix16_overflow && end == row);
+        TEST(fix16_from_strn("7", 0, &end) == fix16_overflow);
+    }
+
     {
         COMMENT("Extended testing for whole range");
         fix16_t value = fix16_minimum;
@@ -103,6 +126,13 @@ int main()
                 printf("Roundtrip failed: (fix16_t)%d -> %s -> (fix16_t)%d\n", value, testbuf, roundtrip);
                 ok = false;
             }
+
+            roundtrip = fix16_from_strn(testbuf, strlen(testbuf), NULL);
+            if (roundtrip != value)
+            {
+                printf("Bounded roundtrip failed: (fix16_t)%d -> %s -> (fix16_t)%d\n", value, testbuf, roundtrip);
+                ok = false;
+            }
         
             value += 0x10001;
         }
@@ -0,0 +1,177 @@
+#include <fix16.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "unittests.h"
+
+#define MAX_LEN 5000
+
+static uint32_t seed = 12345;
+
+static uint32_t next_random(void)
+{
+    seed = seed * 1664525 + 1013904223;
+    return seed;
+}
+
+// Mixes values of every size with the edge cases of saturation,
+// overflow and rounding.
+static fix16_t random_value(int range)
+{
+    static const fix16_t edges[] = {
+        0, 1, -1, 0x7FFF, 0x8000, -0x8000, fix16_one, -fix16_one,
+        0x7FFFFFFF, -0x7FFFFFFF, (fix16_t)0x80000000, 0x00B504F3, -0x00B504F3
+    };
+    uint32_t r = next_random();
+
+    switch (range)
+    {
+        case 0: return r;
+        case 1: return (int32_t)r >> 12;
+        case 2: return (int32_t)r >> 20;
+        default: return edges[(r >> 8) % (sizeof(edges) / sizeof(edges[0]))];
+    }
+}
+
+static fix16_t a[MAX_LEN], b[MAX_LEN], c[MAX_LEN], expect[MAX_LEN];
+
+static bool same(const fix16_t *x, const fix16_t *y, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        if (x[i] != y[i])
+        {
+            printf("%zu: %d != %d\n", i, x[i], y[i]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool check(size_t n, int range)
+{
+    bool ok = true;
+    fix16_t s = random_value(range);
+    fix16_t lo = random_value(2), hi = random_value(1);
+    fix16_t acc, sum, lowest, highest;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+    {
+        a[i] = random_value(range);
+        b[i] = random_value(range);
+    }
+
+    for (i = 0; i < n; i++) expect[i] = fix16_sadd(a[i], b[i]);
+    fix16_vec_add(c, a, b, n);
+    ok = ok && same(c, expect, n);
+
+    for (i = 0; i < n; i++) expect[i] = fix16_ssub(a[i], b[i]);
+    fix16_vec_sub(c, a, b, n);
+    ok = ok && same(c, expect, n);
+
+    for (i = 0; i < n; i++) expect[i] = fix16_smul(a[i], b[i]);
+    fix16_vec_mul(c, a, b, n);
+    ok = ok && same(c, expect, n);
+
+    for (i = 0; i < n; i++) expect[i] = fix16_smul(a[i], s);
+    fix16_vec_scale(c, a, s, n);
+    ok = ok && same(c, expect, n);
+
+    for (i = 0; i < n; i++) expect[i] = fix16_clamp(a[i], lo, hi);
+    fix16_vec_clamp(c, a, lo, hi, n);
+    ok = ok && same(c, expect, n);
+
+    for (i = 0; i < n; i++)
+    {
+        c[i] = b[i];
+        expect[i] = fix16_sadd(b[i], fix16_smul(s, a[i]));
+    }
+    fix16_vec_axpy(c, s, a, n);
+    ok = ok && same(c, expect, n);
+
+    // In place, as when summing into an existing array.
+    for (i = 0; i < n; i++) expect[i] = fix16_sadd(a[i], b[i]);
+    for (i = 0; i < n; i++) c[i] = a[i];
+    fix16_vec_add(c, c, b, n);
+    ok = ok && same(c, expect, n);
+
+    acc = s;
+    sum = 0;
+    lowest = fix16_maximum;
+    highest = fix16_minimum;
+    for (i = 0; i < n; i++)
+    {
+        acc = fix16_sadd(acc, fix16_smul(a[i], b[i]));
+        sum = fix16_sadd(sum, a[i]);
+        lowest = fix16_min(lowest, a[i]);
+        highest = fix16_max(highest, a[i]);
+    }
+
+    if (fix16_vec_dot(s, a, b, n) != acc)
+    {
+        printf("dot: %d != %d\n", fix16_vec_dot(s, a, b, n), acc);
+        ok = false;
+    }
+
+    ok = ok && fix16_vec_sum(a, n) == sum;
+    ok = ok && fix16_vec_min(a, n) == lowest;
+    ok = ok && fix16_vec_max(a, n) == highest;
+
+    if (!ok)
+        printf("Failed with n = %zu, range %d\n", n, range);
+
+    return ok;
+}
+
+int main()
+{
+    int status = 0;
+
+    {
+        COMMENT("Testing fix16_vec functions against the scalar operations");
+        bool ok = true;
+
+        for (int range = 0; range < 4; range++)
+        {
+            for (size_t n = 0; n <= 40; n++)
+            {
+                for (int round = 0; round < 50; round++)
+                    ok = ok && check(n, range);
+            }
+
+            ok = ok && check(1000, range);
+            ok = ok && check(MAX_LEN, range);
+        }
+
+        TEST(ok);
+    }
+
+    {
+        COMMENT("Testing fix16_vec corner cases");
+        fix16_t x[9] = {
+            fix16_maximum, fix16_one, fix16_one, fix16_one,
+            fix16_one, fix16_one, fix16_one, fix16_one, fix16_one
+        };
+        fix16_t y[9] = {
+            fix16_one, -fix16_one, -fix16_one, -fix16_one,
+            -fix16_one, -fix16_one, -fix16_one, -fix16_one, -fix16_one
+        };
+
+        // Saturates on the first term, and the rest are then subtracted.
+        TEST(fix16_vec_dot(0, x, x, 9) == fix16_maximum);
+        TEST(fix16_vec_dot(0, x, y, 9) == fix16_maximum - 8 * fix16_one);
+        TEST(fix16_vec_sum(x, 9) == fix16_maximum);
+        TEST(fix16_vec_sum(y, 9) == -7 * fix16_one);
+        TEST(fix16_vec_dot(fix16_minimum, y, y, 0) == fix16_minimum);
+        TEST(fix16_vec_sum(x, 0) == 0);
+        TEST(fix16_vec_min(x, 0) == fix16_maximum);
+        TEST(fix16_vec_max(x, 0) == fix16_minimum);
+        TEST(fix16_vec_min(y, 9) == -fix16_one);
+        TEST(fix16_vec_max(x, 9) == fix16_maximum);
+    }
+
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+
+    return status;
+}
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include <uneural.h>
+
+/* Tables cover [-UNEURAL_ACTIVATION_TABLE_RANGE,
+ * UNEURAL_ACTIVATION_TABLE_RANGE]. Beyond +/-16 sigmoid is within one
+ * fix16 unit of 0 or 1, so the end samples are returned directly */
+#define TABLE_HALF_SPAN ((int32_t)UNEURAL_ACTIVATION_TABLE_RANGE << 16)
+#define TABLE_SPAN_BITS 21
+
+static int uneural_activation_table_log2(uint16_t size)
+{
+	int bits = 0;
+
+	while ((1u << bits) < size) {
+		bits++;
+	}
+
+	/* Only powers of two between 16 and 32768 intervals are allowed,
+	 * so that each lookup is a shift and a mask */
+	if ((1u << bits) != size || bits < 4 || bits > 15) {
+		return -1;
+	}
+
+	return bits;
+}
+
+ssize_t uneural_activation_table_get_data_requirement(uint16_t size)
+{
+	if (uneural_activation_table_log2(size) < 0) {
+		return -ACTIVATION_TABLE_SIZE;
+	}
+
+	/* One sample at each interval boundary */
+	return (size + 1) * sizeof(fix16_t);
+}
+
+int uneural_activation_table_init(struct uneural_activation_table *t,
+                                  fix16_t *data,
+                                  ssize_t data_size,
+                                  uint16_t size)
+{
+	if (t == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	int bits = uneural_activation_table_log2(size);
+
+	if (bits < 0) {
+		return -ACTIVATION_TABLE_SIZE;
+	}
+
+	if (data_size < uneural_activation_table_get_data_requirement(size)) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	t->sigmoid = data;
+	t->size = size;
+	t->shift = TABLE_SPAN_BITS - bits;
+
+	/* Sample the exact implementation so the table agrees with it at
+	 * every interval boundary */
+	for (int i = 0; i <= size; i++) {
+		fix16_t x = -TABLE_HALF_SPAN + ((int32_t)i << t->shift);
+
+		t->sigmoid[i] = uneural_activate_sigmoid(x);
+	}
+
+	return 0;
+}
+
+fix16_t uneural_activation_table_sigmoid(const struct uneural_activation_table *t,
+                                         fix16_t x)
+{
+	if (x <= -TABLE_HALF_SPAN) {
+		return t->sigmoid[0];
+	}
+
+	if (x >= TABLE_HALF_SPAN) {
+		return t->sigmoid[t->size];
+	}
+
+	/* Linear interpolation between the two surrounding samples */
+	uint32_t pos = (uint32_t)(x + TABLE_HALF_SPAN);
+	uint32_t index = pos >> t->shift;
+	int64_t frac = pos & ((1u << t->shift) - 1);
+	fix16_t y0 = t->sigmoid[index];
+	fix16_t y1 = t->sigmoid[index + 1];
+
+	return y0 + (fix16_t)((((y1 - y0) * frac) +
+			       (1 << (t->shift - 1))) >> t->shift);
+}
+
+fix16_t uneural_activation_table_tanh(const struct uneural_activation_table *t,
+                                      fix16_t x)
+{
+	/* 2*sigmoid(2*x) - 1, as in uneural_activate_tanh */
+	fix16_t temp = uneural_activation_table_sigmoid(t, fix16_smul(x, F16(2)));
+
+	return fix16_ssub(fix16_smul(temp, F16(2)), F16(1));
+}
+
+static fix16_t uneural_abs_diff(fix16_t a, fix16_t b)
+{
+	return (a > b) ? (a - b) : (b - a);
+}
+
+fix16_t uneural_activation_table_max_error(const struct uneural_activation_table *t)
+{
+	fix16_t max_error = 0;
+
+	if (t == NULL || t->sigmoid == NULL) {
+		return -NULL_ARG;
+	}
+
+	/* The interpolation error of the table and the rounding of the
+	 * exact functions do not line up in any simple pattern, so compare
+	 * both lookups with the exact implementations at every fix16
+	 * input in the table's range. Outside it the table returns its end
+	 * samples, which are within one unit of the exact limits */
+	for (fix16_t x = -TABLE_HALF_SPAN; x <= TABLE_HALF_SPAN; x++) {
+		fix16_t err;
+
+		err = uneural_abs_diff(uneural_activation_table_sigmoid(t, x),
+				       uneural_activate_sigmoid(x));
+		max_error = fix16_max(max_error, err);
+
+		err = uneural_abs_diff(uneural_activation_table_tanh(t, x),
+				       uneural_activate_tanh(x));
+		max_error = fix16_max(max_error, err);
+	}
+
+	return max_error;
+}
+
+int uneural_network_set_activation_table(struct uneural_network *n,
+                                         const struct uneural_activation_table *t)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	/* NULL switches back to the exact activation functions */
+	n->act_table = t;
+
+	return 0;
+}
@@ -0,0 +1,294 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <inttypes.h>
+
+#include <uneural.h>
+
+/* Writes a fix16_t as a C literal. INT32_MIN has no literal form of its
+ * own, so it is spelled as an expression */
+static void uneural_emit_fix16(FILE *out, fix16_t value)
+{
+	if (value == fix16_minimum) {
+		fprintf(out, "(-2147483647 - 1)");
+	} else {
+		fprintf(out, "%" PRId32, value);
+	}
+}
+
+static const char *uneural_emit_activation(const struct uneural_network *n,
+                                           uint32_t n_type)
+{
+	switch (n_type) {
+	case NEURON_TYPE_SIGMOID:
+		return n->act_table ? "uneural_activation_table_sigmoid" :
+			"uneural_activate_sigmoid";
+	case NEURON_TYPE_TANH:
+		return n->act_table ? "uneural_activation_table_tanh" :
+			"uneural_activate_tanh";
+	case NEURON_TYPE_RELU:
+		return "uneural_activate_relu";
+	case NEURON_TYPE_LEAKY_RELU:
+		return "uneural_activate_leaky_relu";
+	}
+
+	return NULL;
+}
+
+static void uneural_emit_table(FILE *out,
+                               const struct uneural_activation_table *t,
+                               const char *name)
+{
+	fprintf(out, "static const fix16_t %s_act_samples[%d] = {",
+		name, t->size + 1);
+
+	for (int i = 0; i <= t->size; i++) {
+		fprintf(out, "%s", (i % 8) ? " " : "\n\t");
+		uneural_emit_fix16(out, t->sigmoid[i]);
+		fprintf(out, ",");
+	}
+
+	/* Lookups never write through the table, so pointing the
+	 * non-const member at const data is safe */
+	fprintf(out, "\n};\n\n");
+	fprintf(out, "static const struct uneural_activation_table %s_act_table = {\n"
+		"\t.sigmoid = (fix16_t*)%s_act_samples,\n"
+		"\t.size = %u,\n"
+		"\t.shift = %u,\n"
+		"};\n\n", name, name, t->size, t->shift);
+}
+
+/* The wide sum is split as struct uneural_wide_sum does, so it stays
+ * exact where a single int64 would overflow */
+static void uneural_emit_wide_helper(FILE *out, const char *name)
+{
+	fprintf(out,
+		"static inline void %s_mac(int64_t *hi, int64_t *lo, int64_t product)\n"
+		"{\n"
+		"\t*hi += product >> 32;\n"
+		"\t*lo += product & 0xFFFFFFFF;\n"
+		"}\n\n", name);
+	fprintf(out,
+		"static inline fix16_t %s_wide(int64_t hi, int64_t lo)\n"
+		"{\n"
+		"\tint64_t acc, result;\n"
+		"\n"
+		"\thi += lo >> 32;\n"
+		"\tlo &= 0xFFFFFFFF;\n"
+		"\tif (hi >= 32768) {\n"
+		"\t\treturn fix16_maximum;\n"
+		"\t}\n"
+		"\tif (hi < -32768) {\n"
+		"\t\treturn fix16_minimum;\n"
+		"\t}\n"
+		"\n"
+		"\tacc = hi * 4294967296 + lo;\n"
+		"\tresult = (acc + 0x7FFF + (acc >= 0)) >> 16;\n"
+		"\n"
+		"\tif (result > fix16_maximum) {\n"
+		"\t\treturn fix16_maximum;\n"
+		"\t}\n"
+		"\tif (result < fix16_minimum) {\n"
+		"\t\treturn fix16_minimum;\n"
+		"\t}\n"
+		"\treturn (fix16_t)result;\n"
+		"}\n\n", name);
+}
+
+/* Emits the statements computing one neuron into dest */
+static void uneural_emit_neuron(FILE *out,
+                                const struct uneural_network *n,
+                                const struct uneural_neuron *neuron,
+                                uint16_t num_inputs,
+                                const char *src,
+                                const char *dest,
+                                int index,
+                                const char *name)
+{
+	const char *activation = uneural_emit_activation(n, *neuron->n_type);
+
+	/* A zero weight contributes nothing in either mode (a saturating
+	 * add of zero is the identity), so it is dropped entirely */
+	if (n->mac_mode == MAC_MODE_WIDE) {
+		fprintf(out, "\thi = 0;\n");
+		fprintf(out, "\tlo = (int64_t)");
+		uneural_emit_fix16(out, neuron->bias[0]);
+		fprintf(out, " * 65536;\n");
+
+		for (int j = 0; j < num_inputs; j++) {
+			if (neuron->weights[j] == 0) {
+				continue;
+			}
+			fprintf(out, "\t%s_mac(&hi, &lo, (int64_t)", name);
+			uneural_emit_fix16(out, neuron->weights[j]);
+			fprintf(out, " * %s[%d]);\n", src, j);
+		}
+
+		fprintf(out, "\tacc = %s_wide(hi, lo);\n", name);
+	} else {
+		fprintf(out, "\tacc = 0;\n");
+
+		for (int j = 0; j < num_inputs; j++) {
+			if (neuron->weights[j] == 0) {
+				continue;
+			}
+			fprintf(out, "\tacc = fix16_sadd(acc, fix16_smul(");
+			uneural_emit_fix16(out, neuron->weights[j]);
+			fprintf(out, ", %s[%d]));\n", src, j);
+		}
+
+		fprintf(out, "\tacc = fix16_sadd(");
+		uneural_emit_fix16(out, neuron->bias[0]);
+		fprintf(out, ", acc);\n");
+	}
+
+	if (n->act_table != NULL && (*neuron->n_type == NEURON_TYPE_SIGMOID ||
+				     *neuron->n_type == NEURON_TYPE_TANH)) {
+		fprintf(out, "\t%s[%d] = %s(&%s_act_table, acc);\n",
+			dest, index, activation, name);
+	} else {
+		fprintf(out, "\t%s[%d] = %s(acc);\n", dest, index, activation);
+	}
+}
+
+int uneural_network_emit_c(struct uneural_network *n,
+                           FILE *out,
+                           const char *name)
+{
+	if (n == NULL || out == NULL || name == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	/* Reject anything uneural_activate_network would fail on before
+	 * writing a single line */
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		for (int i = 0; i < l->num_neurons; i++) {
+			if (uneural_emit_activation(n, *l->neurons[i].n_type) == NULL) {
+				return -1;
+			}
+		}
+	}
+
+	fprintf(out,
+		"/* Generated by uneural_network_emit_c(), do not edit.\n"
+		" * Straight-line inference for a %u input, %u output network */\n\n"
+		"#include <stdint.h>\n"
+		"#include <fix16.h>\n"
+		"#include <uneural.h>\n\n",
+		n->input->num_neurons, n->output->num_neurons);
+
+	if (n->act_table != NULL) {
+		uneural_emit_table(out, n->act_table, name);
+	}
+
+	if (n->mac_mode == MAC_MODE_WIDE) {
+		uneural_emit_wide_helper(out, name);
+	}
+
+	fprintf(out, "void %s(const fix16_t *input, fix16_t *output)\n{\n", name);
+
+	/* Every hidden layer gets its own array, so the compiler is free
+	 * to keep as much of it in registers as it likes */
+	int depth = 1;
+
+	for (struct uneural_layer *l = n->input->next; l != n->output; l = l->next) {
+		fprintf(out, "\tfix16_t l%d[%u];\n", depth++, l->num_neurons);
+	}
+
+	fprintf(out, "\tfix16_t acc;\n");
+
+	if (n->mac_mode == MAC_MODE_WIDE) {
+		fprintf(out, "\tint64_t hi, lo;\n");
+	}
+
+	char src[16] = "input";
+	char dest[16];
+
+	depth = 1;
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		if (l == n->output) {
+			snprintf(dest, sizeof(dest), "output");
+		} else {
+			snprintf(dest, sizeof(dest), "l%d", depth);
+		}
+
+		fprintf(out, "\n\t/* Layer %d */\n", depth);
+
+		for (int i = 0; i < l->num_neurons; i++) {
+			uneural_emit_neuron(out, n, &l->neurons[i],
+					    l->prev->num_neurons,
+					    src, dest, i, name);
+		}
+
+		snprintf(src, sizeof(src), "%s", dest);
+		depth++;
+	}
+
+	fprintf(out, "}\n");
+
+	return ferror(out) ? -1 : 0;
+}
+
+int uneural_network_emit_storage(struct uneural_network *n,
+                                 FILE *out,
+                                 const char *name)
+{
+	if (n == NULL || out == NULL || name == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	if (n->storage_attached == false || n->storage == NULL) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	ssize_t count = n->storage_size / sizeof(fix16_t);
+
+	fprintf(out,
+		"/* Generated by uneural_network_emit_storage(), do not edit.\n"
+		" * %s layout storage for a network of layers",
+		(n->layout == STORAGE_LAYOUT_LAYER) ? "Layer" : "Neuron");
+
+	for (struct uneural_layer *l = n->input; l != NULL; l = l->next) {
+		fprintf(out, " %u", l->num_neurons);
+	}
+
+	/* Aligned for either layout, and const so that it stays in flash
+	 * or read-only pages */
+	fprintf(out,
+		",\n * to be attached with uneural_network_data_attach_const() */\n\n"
+		"#include <stdint.h>\n"
+		"#include <fix16.h>\n\n"
+		"static const fix16_t %s[%zd] __attribute__((aligned(%d))) = {",
+		name, count, UNEURAL_CACHE_LINE);
+
+	for (ssize_t i = 0; i < count; i++) {
+		fprintf(out, "%s", (i % 8) ? " " : "\n\t");
+		uneural_emit_fix16(out, n->storage[i]);
+		fprintf(out, ",");
+	}
+
+	fprintf(out, "\n};\n");
+
+	return ferror(out) ? -1 : 0;
+}
@@ -0,0 +1,249 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifndef UNEURAL_NO_THREADS
+#include <pthread.h>
+#endif
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+/* Below this many bytes per thread, starting the thread costs more
+ * than it saves */
+#define UNEURAL_CSV_MIN_CHUNK 65536
+
+/* Each worker parses whole lines from [start, end) into the rows
+ * starting at out */
+struct uneural_csv_chunk {
+	const char *start;
+	const char *end;
+	size_t rows;
+	fix16_t *out;
+	char delimiter;
+	uint16_t columns;
+	int result;
+#ifndef UNEURAL_NO_THREADS
+	pthread_t thread;
+	bool started;
+#endif
+};
+
+static bool uneural_csv_blank(const char *p, const char *eol)
+{
+	for (; p < eol; p++) {
+		if (*p != ' ' && *p != '\t') {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* Finds the end of the line starting at p, returning where the next one
+ * starts and storing the end of this one, less any '\r', in eol */
+static const char *uneural_csv_line(const char *p,
+                                    const char *end,
+                                    const char **eol)
+{
+	const char *nl = memchr(p, '\n', end - p);
+	const char *next = (nl != NULL) ? nl + 1 : end;
+
+	if (nl == NULL) {
+		nl = end;
+	}
+
+	if (nl > p && nl[-1] == '\r') {
+		nl--;
+	}
+
+	*eol = nl;
+
+	return next;
+}
+
+static size_t uneural_csv_count(const char *p, const char *end)
+{
+	size_t rows = 0;
+
+	while (p < end) {
+		const char *eol;
+		const char *next = uneural_csv_line(p, end, &eol);
+
+		rows += !uneural_csv_blank(p, eol);
+		p = next;
+	}
+
+	return rows;
+}
+
+static int uneural_csv_parse_row(const char *p,
+                                 const char *eol,
+                                 char delimiter,
+                                 uint16_t columns,
+                                 fix16_t *row)
+{
+	for (int c = 0; c < columns; c++) {
+		const char *num_end;
+
+		row[c] = fix16_from_strn(p, eol - p, &num_end);
+
+		if (num_end == p) {
+			return -CSV_FORMAT;
+		}
+
+		p = num_end;
+
+		while (p < eol && (*p == ' ' || *p == '\t')) {
+			p++;
+		}
+
+		if (c + 1 < columns) {
+			if (p == eol || *p != delimiter) {
+				return -CSV_FORMAT;
+			}
+			p++;
+		}
+	}
+
+	return (p == eol) ? 0 : -CSV_FORMAT;
+}
+
+static void *uneural_csv_run(void *arg)
+{
+	struct uneural_csv_chunk *chunk = arg;
+	const char *p = chunk->start;
+	fix16_t *row = chunk->out;
+
+	chunk->result = 0;
+
+	while (p < chunk->end) {
+		const char *eol;
+		const char *next = uneural_csv_line(p, chunk->end, &eol);
+
+		if (!uneural_csv_blank(p, eol)) {
+			chunk->result = uneural_csv_parse_row(p, eol,
+							      chunk->delimiter,
+							      chunk->columns, row);
+			if (chunk->result) {
+				break;
+			}
+
+			row += chunk->columns;
+		}
+
+		p = next;
+	}
+
+	return NULL;
+}
+
+ssize_t uneural_csv_count_rows(const char *text, size_t length)
+{
+	if (text == NULL) {
+		return -NULL_ARG;
+	}
+
+	return uneural_csv_count(text, text + length);
+}
+
+ssize_t uneural_csv_parse(const char *text,
+                          size_t length,
+                          char delimiter,
+                          uint16_t columns,
+                          fix16_t *out,
+                          size_t max_rows,
+                          uint16_t num_threads)
+{
+	if (text == NULL || out == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (columns == 0) {
+		return -CSV_FORMAT;
+	}
+
+	if (num_threads == 0) {
+		num_threads = 1;
+	}
+
+	if (num_threads > UNEURAL_MAX_THREADS) {
+		num_threads = UNEURAL_MAX_THREADS;
+	}
+
+	if (num_threads > length / UNEURAL_CSV_MIN_CHUNK) {
+		num_threads = length / UNEURAL_CSV_MIN_CHUNK + 1;
+	}
+
+	struct uneural_csv_chunk chunks[num_threads];
+	const char *end = text + length;
+	const char *start = text;
+	size_t rows = 0;
+
+	/* Cut the text into near equal shares, moving each cut forward to
+	 * the start of a line. Counting rows first gives every share the
+	 * index of its first row, so all of them can be parsed at once */
+	for (int t = 0; t < num_threads; t++) {
+		struct uneural_csv_chunk *chunk = &chunks[t];
+		const char *cut = text + (uint64_t)length * (t + 1) / num_threads;
+
+		if (cut < start) {
+			cut = start;
+		}
+
+		if (cut < end && cut > text && cut[-1] != '\n') {
+			const char *nl = memchr(cut, '\n', end - cut);
+
+			cut = (nl != NULL) ? nl + 1 : end;
+		}
+
+		chunk->start = start;
+		chunk->end = cut;
+		chunk->rows = uneural_csv_count(start, cut);
+		chunk->out = &out[rows * columns];
+		chunk->delimiter = delimiter;
+		chunk->columns = columns;
+
+		rows += chunk->rows;
+		start = cut;
+	}
+
+	if (rows > max_rows) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+#ifndef UNEURAL_NO_THREADS
+	/* As in uneural_network_train_parallel, the calling thread parses
+	 * the first share and a share without a thread is parsed inline */
+	for (int t = 1; t < num_threads; t++) {
+		chunks[t].started = pthread_create(&chunks[t].thread, NULL,
+						   uneural_csv_run,
+						   &chunks[t]) == 0;
+	}
+
+	uneural_csv_run(&chunks[0]);
+
+	for (int t = 1; t < num_threads; t++) {
+		if (chunks[t].started) {
+			pthread_join(chunks[t].thread, NULL);
+		} else {
+			uneural_csv_run(&chunks[t]);
+		}
+	}
+#else
+	for (int t = 0; t < num_threads; t++) {
+		uneural_csv_run(&chunks[t]);
+	}
+#endif
+
+	for (int t = 0; t < num_threads; t++) {
+		if (chunks[t].result) {
+			return chunks[t].result;
+		}
+	}
+
+	return rows;
+}
@@ -0,0 +1,201 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <uneural.h>
+
+#ifndef UNEURAL_NO_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define DATASET_MAGIC 0x53444E55
+#define DATASET_VERSION 1
+
+/* A dataset file is this header, zero padded to
+ * UNEURAL_DATASET_HEADER_SIZE bytes, followed by count rows of
+ * input_width inputs and then target_width targets, all fix16_t in the
+ * host's byte order */
+struct uneural_dataset_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint32_t count;
+	uint16_t input_width;
+	uint16_t target_width;
+};
+
+static size_t uneural_dataset_row_size(uint16_t input_width,
+                                       uint16_t target_width)
+{
+	return ((size_t)input_width + target_width) * sizeof(fix16_t);
+}
+
+int uneural_dataset_save(const char *path,
+                         const struct uneural_dataset *data,
+                         uint16_t input_width,
+                         uint16_t target_width)
+{
+	if (path == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (data->inputs == NULL && data->get == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (data->inputs != NULL && data->targets == NULL) {
+		return -NULL_ARG;
+	}
+
+	if ((data->input_width && data->input_width != input_width) ||
+	    (data->target_width && data->target_width != target_width)) {
+		return -DATASET_SHAPE_MISMATCH;
+	}
+
+	FILE *f = fopen(path, "wb");
+
+	if (f == NULL) {
+		return -DATASET_IO;
+	}
+
+	uint8_t header[UNEURAL_DATASET_HEADER_SIZE] = {0};
+	struct uneural_dataset_header h = {
+		.magic = DATASET_MAGIC,
+		.version = DATASET_VERSION,
+		.header_size = UNEURAL_DATASET_HEADER_SIZE,
+		.count = data->count,
+		.input_width = input_width,
+		.target_width = target_width,
+	};
+	int res = 0;
+
+	memcpy(header, &h, sizeof(h));
+
+	if (fwrite(header, sizeof(header), 1, f) != 1) {
+		res = -DATASET_IO;
+	}
+
+	size_t input_stride = data->input_stride ? data->input_stride : input_width;
+	size_t target_stride = data->target_stride ? data->target_stride : target_width;
+
+	for (uint32_t s = 0; s < data->count && res == 0; s++) {
+		const fix16_t *input;
+		const fix16_t *target;
+
+		if (data->inputs != NULL) {
+			input = &data->inputs[s * input_stride];
+			target = &data->targets[s * target_stride];
+		} else {
+			res = data->get(data->arg, s, &input, &target);
+			if (res) {
+				break;
+			}
+		}
+
+		if (fwrite(input, sizeof(fix16_t), input_width, f) != input_width ||
+		    fwrite(target, sizeof(fix16_t), target_width, f) != target_width) {
+			res = -DATASET_IO;
+		}
+	}
+
+	if (fclose(f) != 0 && res == 0) {
+		res = -DATASET_IO;
+	}
+
+	return res;
+}
+
+int uneural_dataset_map(const char *path,
+                        struct uneural_dataset *data,
+                        struct uneural_dataset_map *map)
+{
+	if (path == NULL || data == NULL || map == NULL) {
+		return -NULL_ARG;
+	}
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return -DATASET_IO;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -DATASET_IO;
+	}
+
+	if ((size_t)st.st_size < UNEURAL_DATASET_HEADER_SIZE) {
+		close(fd);
+		return -DATASET_FORMAT;
+	}
+
+	/* Read only and shared, so samples come straight out of the page
+	 * cache and files larger than memory simply page in and out */
+	void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		return -DATASET_IO;
+	}
+
+	const struct uneural_dataset_header *h = addr;
+	size_t row_size = uneural_dataset_row_size(h->input_width, h->target_width);
+
+	/* count comes from the file, so it is checked by dividing rather
+	 * than multiplying, which could wrap on 32 bit hosts */
+	if (h->magic != DATASET_MAGIC || h->version != DATASET_VERSION ||
+	    h->header_size < sizeof(*h) || h->header_size % sizeof(fix16_t) ||
+	    h->header_size > (size_t)st.st_size ||
+	    (row_size != 0 &&
+	     h->count > ((size_t)st.st_size - h->header_size) / row_size)) {
+		munmap(addr, st.st_size);
+		return -DATASET_FORMAT;
+	}
+
+	const fix16_t *rows = (const fix16_t*)((const uint8_t*)addr + h->header_size);
+
+	map->addr = addr;
+	map->length = st.st_size;
+	map->input_width = h->input_width;
+	map->target_width = h->target_width;
+
+	data->count = h->count;
+	data->input_width = h->input_width;
+	data->target_width = h->target_width;
+	data->inputs = rows;
+	data->targets = rows + h->input_width;
+	data->input_stride = h->input_width + h->target_width;
+	data->target_stride = h->input_width + h->target_width;
+	data->get = NULL;
+	data->arg = NULL;
+
+	return 0;
+}
+
+int uneural_dataset_unmap(struct uneural_dataset_map *map)
+{
+	if (map == NULL || map->addr == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (munmap(map->addr, map->length) != 0) {
+		return -DATASET_IO;
+	}
+
+	map->addr = NULL;
+	map->length = 0;
+
+	return 0;
+}
+
+#endif  /* UNEURAL_NO_MMAP */
@@ -0,0 +1,280 @@
+#include <stdint.h>
+#include <stddef.h>
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+/* Raw (unrounded, unsaturated) sums of products for the wide and
+ * quantized accumulation modes. The saturating dot product is
+ * libfixmath's fix16_vec_dot. These kernels never go through fix16_mul,
+ * so they do not depend on libfixmath's configuration */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+	!defined(UNEURAL_NO_SIMD)
+#define UNEURAL_DOT_X86
+#include <immintrin.h>
+#endif
+
+static struct uneural_wide_sum uneural_dot_wide_scalar(struct uneural_wide_sum acc,
+                                                       const fix16_t *weights,
+                                                       const fix16_t *inputs,
+                                                       uint16_t count)
+{
+	for (int i = 0; i < count; i++) {
+		uneural_wide_sum_mac(&acc, weights[i], inputs[i]);
+	}
+
+	return acc;
+}
+
+static int64_t uneural_dot_q8_scalar(int64_t acc,
+                                     const int8_t *weights,
+                                     const fix16_t *inputs,
+                                     uint16_t count)
+{
+	for (int i = 0; i < count; i++) {
+		acc += (int64_t)weights[i] * inputs[i];
+	}
+
+	return acc;
+}
+
+#ifdef UNEURAL_DOT_X86
+
+/* Splits each 64 bit lane product as uneural_wide_sum_mac does: the
+ * high dword goes to hi, sign extended from the sign the arithmetic
+ * shift leaves in the high dword, and the low dword to lo */
+__attribute__((target("sse4.1")))
+static inline void uneural_dot_wide_split_sse41(__m128i product,
+                                                __m128i *hi,
+                                                __m128i *lo)
+{
+	*hi = _mm_add_epi64(*hi, _mm_blend_epi16(_mm_srli_epi64(product, 32),
+						 _mm_srai_epi32(product, 31),
+						 0xCC));
+	*lo = _mm_add_epi64(*lo, _mm_and_si128(product,
+					       _mm_set1_epi64x(0xFFFFFFFF)));
+}
+
+__attribute__((target("sse4.1")))
+static struct uneural_wide_sum uneural_dot_wide_sse41(struct uneural_wide_sum acc,
+                                                      const fix16_t *weights,
+                                                      const fix16_t *inputs,
+                                                      uint16_t count)
+{
+	__m128i hi = _mm_setzero_si128();
+	__m128i lo = _mm_setzero_si128();
+	int64_t lanes[2];
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		__m128i w = _mm_loadu_si128((const __m128i*)&weights[i]);
+		__m128i x = _mm_loadu_si128((const __m128i*)&inputs[i]);
+
+		uneural_dot_wide_split_sse41(_mm_mul_epi32(w, x), &hi, &lo);
+		uneural_dot_wide_split_sse41(_mm_mul_epi32(_mm_srli_epi64(w, 32),
+							   _mm_srli_epi64(x, 32)),
+					     &hi, &lo);
+	}
+
+	_mm_storeu_si128((__m128i*)lanes, hi);
+	acc.hi += lanes[0] + lanes[1];
+	_mm_storeu_si128((__m128i*)lanes, lo);
+	acc.lo += lanes[0] + lanes[1];
+
+	return uneural_dot_wide_scalar(acc, &weights[i], &inputs[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static inline void uneural_dot_wide_split_avx2(__m256i product,
+                                               __m256i *hi,
+                                               __m256i *lo)
+{
+	*hi = _mm256_add_epi64(*hi, _mm256_blend_epi32(_mm256_srli_epi64(product, 32),
+						       _mm256_srai_epi32(product, 31),
+						       0xAA));
+	*lo = _mm256_add_epi64(*lo, _mm256_and_si256(product,
+						     _mm256_set1_epi64x(0xFFFFFFFF)));
+}
+
+__attribute__((target("avx2")))
+static struct uneural_wide_sum uneural_dot_wide_avx2(struct uneural_wide_sum acc,
+                                                     const fix16_t *weights,
+                                                     const fix16_t *inputs,
+                                                     uint16_t count)
+{
+	__m256i hi = _mm256_setzero_si256();
+	__m256i lo = _mm256_setzero_si256();
+	int64_t lanes[4];
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m256i w = _mm256_loadu_si256((const __m256i*)&weights[i]);
+		__m256i x = _mm256_loadu_si256((const __m256i*)&inputs[i]);
+
+		uneural_dot_wide_split_avx2(_mm256_mul_epi32(w, x), &hi, &lo);
+		uneural_dot_wide_split_avx2(_mm256_mul_epi32(_mm256_srli_epi64(w, 32),
+							     _mm256_srli_epi64(x, 32)),
+					    &hi, &lo);
+	}
+
+	_mm256_storeu_si256((__m256i*)lanes, hi);
+	acc.hi += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+	_mm256_storeu_si256((__m256i*)lanes, lo);
+	acc.lo += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+	return uneural_dot_wide_scalar(acc, &weights[i], &inputs[i], count - i);
+}
+
+/* The int8 kernels sign extend the weights to 32 bits and then reuse
+ * the even/odd lane 32x32->64 multiplies of the wide kernels */
+__attribute__((target("sse4.1")))
+static int64_t uneural_dot_q8_sse41(int64_t acc,
+                                    const int8_t *weights,
+                                    const fix16_t *inputs,
+                                    uint16_t count)
+{
+	__m128i vsum = _mm_setzero_si128();
+	int64_t lanes[2];
+	int i;
+
+	for (i = 0; i + 4 <= count; i += 4) {
+		int32_t packed;
+
+		__builtin_memcpy(&packed, &weights[i], sizeof(packed));
+
+		__m128i w = _mm_cvtepi8_epi32(_mm_cvtsi32_si128(packed));
+		__m128i x = _mm_loadu_si128((const __m128i*)&inputs[i]);
+
+		vsum = _mm_add_epi64(vsum, _mm_mul_epi32(w, x));
+		vsum = _mm_add_epi64(vsum, _mm_mul_epi32(_mm_srli_epi64(w, 32),
+							 _mm_srli_epi64(x, 32)));
+	}
+
+	_mm_storeu_si128((__m128i*)lanes, vsum);
+	acc += lanes[0] + lanes[1];
+
+	return uneural_dot_q8_scalar(acc, &weights[i], &inputs[i], count - i);
+}
+
+__attribute__((target("avx2")))
+static int64_t uneural_dot_q8_avx2(int64_t acc,
+                                   const int8_t *weights,
+                                   const fix16_t *inputs,
+                                   uint16_t count)
+{
+	__m256i vsum = _mm256_setzero_si256();
+	int64_t lanes[4];
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		__m256i w = _mm256_cvtepi8_epi32(_mm_loadl_epi64((const __m128i*)&weights[i]));
+		__m256i x = _mm256_loadu_si256((const __m256i*)&inputs[i]);
+
+		vsum = _mm256_add_epi64(vsum, _mm256_mul_epi32(w, x));
+		vsum = _mm256_add_epi64(vsum,
+					_mm256_mul_epi32(_mm256_srli_epi64(w, 32),
+							 _mm256_srli_epi64(x, 32)));
+	}
+
+	_mm256_storeu_si256((__m256i*)lanes, vsum);
+	acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+	return uneural_dot_q8_scalar(acc, &weights[i], &inputs[i], count - i);
+}
+
+typedef struct uneural_wide_sum (*uneural_dot_wide_kernel_t)(struct uneural_wide_sum acc,
+                                                             const fix16_t *weights,
+                                                             const fix16_t *inputs,
+                                                             uint16_t count);
+
+typedef int64_t (*uneural_dot_q8_kernel_t)(int64_t acc,
+                                           const int8_t *weights,
+                                           const fix16_t *inputs,
+                                           uint16_t count);
+
+static struct uneural_wide_sum uneural_dot_wide_resolve(struct uneural_wide_sum acc,
+                                                        const fix16_t *weights,
+                                                        const fix16_t *inputs,
+                                                        uint16_t count);
+static int64_t uneural_dot_q8_resolve(int64_t acc,
+                                      const int8_t *weights,
+                                      const fix16_t *inputs,
+                                      uint16_t count);
+
+static uneural_dot_wide_kernel_t uneural_dot_wide_kernel = uneural_dot_wide_resolve;
+static uneural_dot_q8_kernel_t uneural_dot_q8_kernel = uneural_dot_q8_resolve;
+
+/* Picks the widest kernels the CPU supports on first use. Racing
+ * threads all store the same pointers, so no locking is needed */
+static void uneural_dot_select(void)
+{
+	uneural_dot_wide_kernel_t wide_kernel = uneural_dot_wide_scalar;
+	uneural_dot_q8_kernel_t q8_kernel = uneural_dot_q8_scalar;
+
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx2")) {
+		wide_kernel = uneural_dot_wide_avx2;
+		q8_kernel = uneural_dot_q8_avx2;
+	} else if (__builtin_cpu_supports("sse4.1")) {
+		wide_kernel = uneural_dot_wide_sse41;
+		q8_kernel = uneural_dot_q8_sse41;
+	}
+
+	__atomic_store_n(&uneural_dot_wide_kernel, wide_kernel, __ATOMIC_RELAXED);
+	__atomic_store_n(&uneural_dot_q8_kernel, q8_kernel, __ATOMIC_RELAXED);
+}
+
+static struct uneural_wide_sum uneural_dot_wide_resolve(struct uneural_wide_sum acc,
+                                                        const fix16_t *weights,
+                                                        const fix16_t *inputs,
+                                                        uint16_t count)
+{
+	uneural_dot_select();
+	return uneural_dot_wide_kernel(acc, weights, inputs, count);
+}
+
+static int64_t uneural_dot_q8_resolve(int64_t acc,
+                                      const int8_t *weights,
+                                      const fix16_t *inputs,
+                                      uint16_t count)
+{
+	uneural_dot_select();
+	return uneural_dot_q8_kernel(acc, weights, inputs, count);
+}
+
+#endif  /* UNEURAL_DOT_X86 */
+
+struct uneural_wide_sum uneural_dot_wide(struct uneural_wide_sum acc,
+                                         const fix16_t *weights,
+                                         const fix16_t *inputs,
+                                         uint16_t count)
+{
+#ifdef UNEURAL_DOT_X86
+	if (count >= 8) {
+		uneural_dot_wide_kernel_t kernel;
+
+		kernel = __atomic_load_n(&uneural_dot_wide_kernel, __ATOMIC_RELAXED);
+		return kernel(acc, weights, inputs, count);
+	}
+#endif
+
+	return uneural_dot_wide_scalar(acc, weights, inputs, count);
+}
+
+int64_t uneural_dot_q8(int64_t acc,
+                       const int8_t *weights,
+                       const fix16_t *inputs,
+                       uint16_t count)
+{
+#ifdef UNEURAL_DOT_X86
+	if (count >= 8) {
+		uneural_dot_q8_kernel_t kernel;
+
+		kernel = __atomic_load_n(&uneural_dot_q8_kernel, __ATOMIC_RELAXED);
+		return kernel(acc, weights, inputs, count);
+	}
+#endif
+
+	return uneural_dot_q8_scalar(acc, weights, inputs, count);
+}
@@ -0,0 +1,350 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+#ifndef UNEURAL_NO_MMAP
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define MODEL_MAGIC 0x4C444D55
+#define MODEL_VERSION 1
+
+/* A model file is this header, followed by one struct
+ * uneural_model_layer per layer (input layer first), zero padded to
+ * header_size bytes, a multiple of UNEURAL_CACHE_LINE. The storage blob
+ * follows exactly as it was attached, so that mapping the file gives
+ * attachable, suitably aligned storage. Everything is in the host's
+ * byte order */
+struct uneural_model_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t header_size;
+	uint16_t num_layers;
+	uint8_t layout;
+	uint8_t mac_mode;
+	uint32_t data_size;
+	/* Of the storage blob, see uneural_model_checksum */
+	uint32_t checksum;
+};
+
+/* Fletcher style sums over the blob's words, so it reads at memory
+ * speed but still catches swapped and shifted words */
+static uint32_t uneural_model_checksum(const uint32_t *data, size_t count)
+{
+	uint64_t a = 0;
+	uint64_t b = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		a += data[i];
+		b += a;
+	}
+
+	return (uint32_t)(a ^ (a >> 32) ^ (b << 1) ^ (b >> 31));
+}
+
+static size_t uneural_model_header_size(uint16_t num_layers)
+{
+	size_t size = sizeof(struct uneural_model_header) +
+		num_layers * sizeof(struct uneural_model_layer);
+
+	return (size + UNEURAL_CACHE_LINE - 1) & ~(size_t)(UNEURAL_CACHE_LINE - 1);
+}
+
+/* The activation shared by every neuron of l, or
+ * UNEURAL_MODEL_MIXED_TYPES */
+static uint16_t uneural_model_layer_type(const struct uneural_layer *l)
+{
+	uint32_t n_type = uneural_layer_type(l, 0);
+
+	for (int i = 1; i < l->num_neurons; i++) {
+		if (uneural_layer_type(l, i) != n_type) {
+			return UNEURAL_MODEL_MIXED_TYPES;
+		}
+	}
+
+	return n_type;
+}
+
+int uneural_model_save(struct uneural_network *n, const char *path)
+{
+	if (n == NULL || path == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	if (n->storage_attached == false || n->storage == NULL) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	uint16_t num_layers = 0;
+
+	for (struct uneural_layer *l = n->input; l != NULL; l = l->next) {
+		num_layers++;
+	}
+
+	struct uneural_model_layer layers[num_layers];
+	int i = 0;
+
+	for (struct uneural_layer *l = n->input; l != NULL; l = l->next, i++) {
+		layers[i].num_neurons = l->num_neurons;
+		layers[i].n_type = (l == n->input) ? 0 : uneural_model_layer_type(l);
+	}
+
+	struct uneural_model_header h = {
+		.magic = MODEL_MAGIC,
+		.version = MODEL_VERSION,
+		.header_size = uneural_model_header_size(num_layers),
+		.num_layers = num_layers,
+		.layout = n->layout,
+		.mac_mode = n->mac_mode,
+		.data_size = n->storage_size,
+		.checksum = uneural_model_checksum((const uint32_t*)n->storage,
+						   n->storage_size / sizeof(uint32_t)),
+	};
+	static const uint8_t zero[UNEURAL_CACHE_LINE];
+	size_t pad = h.header_size - sizeof(h) - sizeof(layers);
+	int res = 0;
+
+	FILE *f = fopen(path, "wb");
+
+	if (f == NULL) {
+		return -MODEL_IO;
+	}
+
+	if (fwrite(&h, sizeof(h), 1, f) != 1 ||
+	    fwrite(layers, sizeof(layers), 1, f) != 1 ||
+	    fwrite(zero, 1, pad, f) != pad ||
+	    fwrite(n->storage, 1, n->storage_size, f) != (size_t)n->storage_size) {
+		res = -MODEL_IO;
+	}
+
+	if (fclose(f) != 0 && res == 0) {
+		res = -MODEL_IO;
+	}
+
+	return res;
+}
+
+int uneural_model_map(const char *path,
+                      struct uneural_model *model,
+                      bool verify)
+{
+	if (path == NULL || model == NULL) {
+		return -NULL_ARG;
+	}
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return -MODEL_IO;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return -MODEL_IO;
+	}
+
+	if ((size_t)st.st_size < sizeof(struct uneural_model_header)) {
+		close(fd);
+		return -MODEL_FORMAT;
+	}
+
+	/* Private and writable: nothing is read until it is used, and the
+	 * pages are only copied if the network is trained further, which
+	 * then never reaches the file */
+	void *addr = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+			  MAP_PRIVATE, fd, 0);
+
+	close(fd);
+
+	if (addr == MAP_FAILED) {
+		return -MODEL_IO;
+	}
+
+	const struct uneural_model_header *h = addr;
+	const struct uneural_model_layer *layers =
+		(const struct uneural_model_layer*)(h + 1);
+	int res = 0;
+
+	if (h->magic != MODEL_MAGIC || h->version != MODEL_VERSION ||
+	    h->num_layers < 2 ||
+	    h->header_size != uneural_model_header_size(h->num_layers) ||
+	    h->layout > STORAGE_LAYOUT_LAYER || h->mac_mode > MAC_MODE_WIDE ||
+	    h->data_size % sizeof(uint32_t) ||
+	    (size_t)st.st_size < (size_t)h->header_size + h->data_size) {
+		res = -MODEL_FORMAT;
+	}
+
+	for (int i = 0; res == 0 && i < h->num_layers; i++) {
+		if (layers[i].num_neurons == 0) {
+			res = -MODEL_FORMAT;
+		}
+
+		if (i == 0 && layers[i].n_type != 0) {
+			res = -MODEL_FORMAT;
+		}
+
+		if (i > 0 && layers[i].n_type > NEURON_TYPE_LEAKY_RELU &&
+		    layers[i].n_type != UNEURAL_MODEL_MIXED_TYPES) {
+			res = -MODEL_FORMAT;
+		}
+	}
+
+	fix16_t *data = (fix16_t*)((uint8_t*)addr + h->header_size);
+
+	if (res == 0 && verify &&
+	    uneural_model_checksum((const uint32_t*)data,
+				   h->data_size / sizeof(uint32_t)) != h->checksum) {
+		res = -MODEL_CHECKSUM;
+	}
+
+	if (res) {
+		munmap(addr, st.st_size);
+		return res;
+	}
+
+	model->addr = addr;
+	model->length = st.st_size;
+	model->num_layers = h->num_layers;
+	model->layers = layers;
+	model->layout = h->layout;
+	model->mac_mode = h->mac_mode;
+	model->data = data;
+	model->data_size = h->data_size;
+
+	return 0;
+}
+
+ssize_t uneural_model_get_network_size(const struct uneural_model *model)
+{
+	if (model == NULL || model->layers == NULL) {
+		return -NULL_ARG;
+	}
+
+	ssize_t size = model->num_layers * sizeof(struct uneural_layer);
+
+	for (int i = 0; i < model->num_layers; i++) {
+		size += model->layers[i].num_neurons * sizeof(struct uneural_neuron);
+	}
+
+	return size;
+}
+
+int uneural_model_build(const struct uneural_model *model,
+                        struct uneural_network *n,
+                        void *buf,
+                        ssize_t buf_size)
+{
+	if (model == NULL || n == NULL || buf == NULL) {
+		return -NULL_ARG;
+	}
+
+	ssize_t required = uneural_model_get_network_size(model);
+
+	if (required < 0) {
+		return required;
+	}
+
+	if (buf_size < required) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	if ((intptr_t)buf % sizeof(void*)) {
+		return -DATA_STORAGE_UNALIGNED;
+	}
+
+	/* Layers first, keeping them pointer aligned, then the (packed)
+	 * neurons of every layer */
+	struct uneural_layer *layers = buf;
+	struct uneural_neuron *neurons = (struct uneural_neuron*)&layers[model->num_layers];
+	int res = 0;
+
+	memset(buf, 0, required);
+	memset(n, 0, sizeof(*n));
+
+	for (int i = 0; i < model->num_layers && res == 0; i++) {
+		struct uneural_layer *l = &layers[i];
+
+		l->num_neurons = model->layers[i].num_neurons;
+		l->neurons = neurons;
+		neurons += l->num_neurons;
+
+		if (i == 0) {
+			res = uneural_network_add_input_layer(n, l);
+		} else if (i + 1 == model->num_layers) {
+			res = uneural_network_add_output_layer(n, l);
+		} else {
+			res = uneural_network_add_hidden_layer(n, l);
+		}
+	}
+
+	if (res == 0) {
+		res = uneural_network_set_storage_layout(n, model->layout);
+	}
+
+	if (res == 0) {
+		res = uneural_network_set_mac_mode(n, model->mac_mode);
+	}
+
+	/* The weights stay where they are in the mapping, attaching only
+	 * points the neurons at them */
+	if (res == 0) {
+		res = uneural_network_data_attach(n, model->data, model->data_size);
+	}
+
+	if (res == 0 && n->storage_size > model->data_size) {
+		res = -MODEL_FORMAT;
+	}
+
+	/* The layer table has to describe the type words in the blob */
+	for (struct uneural_layer *l = n->input->next; res == 0 && l != NULL; l = l->next) {
+		if (model->layers[l - layers].n_type != uneural_model_layer_type(l)) {
+			res = -MODEL_FORMAT;
+		}
+	}
+
+	if (res) {
+		n->storage_attached = false;
+	}
+
+	return res;
+}
+
+int uneural_model_unmap(struct uneural_model *model)
+{
+	if (model == NULL || model->addr == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (munmap(model->addr, model->length) != 0) {
+		return -MODEL_IO;
+	}
+
+	model->addr = NULL;
+	model->length = 0;
+	model->layers = NULL;
+	model->data = NULL;
+
+	return 0;
+}
+
+#endif  /* UNEURAL_NO_MMAP */
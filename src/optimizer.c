@@ -0,0 +1,292 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+/* Adam's second moment is kept scaled up by 2^UNEURAL_ADAM_V_SHIFT, as
+ * squared gradients are mostly far below one fix16 unit otherwise */
+#define UNEURAL_ADAM_V_SHIFT 8
+
+static int uneural_optimizer_state_per_param(enum optimizer_type type)
+{
+	switch (type) {
+	case OPTIMIZER_SGD:
+		return 0;
+	case OPTIMIZER_MOMENTUM:
+	case OPTIMIZER_NESTEROV:
+		return 1;
+	case OPTIMIZER_ADAM:
+	case OPTIMIZER_RPROP:
+		return 2;
+	}
+
+	return -1;
+}
+
+ssize_t uneural_optimizer_get_state_size(struct uneural_network *n,
+                                         enum optimizer_type type)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	int per_param = uneural_optimizer_state_per_param(type);
+
+	if (per_param < 0) {
+		return -1;
+	}
+
+	return per_param * uneural_network_gradient_count(n) * sizeof(fix16_t);
+}
+
+int uneural_optimizer_init(struct uneural_optimizer *opt,
+                           struct uneural_network *n,
+                           enum optimizer_type type,
+                           fix16_t training_rate,
+                           fix16_t *state,
+                           ssize_t state_size)
+{
+	if (opt == NULL || n == NULL) {
+		return -NULL_ARG;
+	}
+
+	ssize_t required = uneural_optimizer_get_state_size(n, type);
+
+	if (required < 0) {
+		return required;
+	}
+
+	if (required > 0 && state == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (state_size < required) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	/* Defaults are picked for Q16.16. (1 - beta2) at the usual 0.999
+	 * is only 66 units, too coarse to average squared gradients */
+	opt->type = type;
+	opt->rate = training_rate;
+	opt->momentum = F16(0.9);
+	opt->beta2 = F16(0.99);
+	opt->epsilon = F16(0.001);
+	opt->beta1_pow = fix16_one;
+	opt->beta2_pow = fix16_one;
+	opt->eta_plus = F16(1.2);
+	opt->eta_minus = F16(0.5);
+	opt->step_min = 1;
+	opt->step_max = F16(50);
+	opt->num_params = uneural_network_gradient_count(n);
+	opt->state = state;
+
+	if (required > 0) {
+		memset(state, 0, required);
+	}
+
+	/* RPROP keeps a step size per weight, starting at the rate, and
+	 * the gradient seen last time */
+	if (type == OPTIMIZER_RPROP) {
+		for (ssize_t k = 0; k < opt->num_params; k++) {
+			state[k] = training_rate;
+		}
+	}
+
+	return 0;
+}
+
+/* iRprop-: only the sign of the gradient is used. The step grows while
+ * the sign holds and shrinks when it flips, in which case the weight is
+ * left alone and the sign forgotten */
+static fix16_t uneural_rprop_step(struct uneural_optimizer *opt,
+                                  ssize_t k,
+                                  fix16_t g)
+{
+	fix16_t *step = &opt->state[k];
+	fix16_t *prev = &opt->state[opt->num_params + k];
+
+	if (g == 0) {
+		*prev = 0;
+		return 0;
+	}
+
+	if ((g > 0 && *prev < 0) || (g < 0 && *prev > 0)) {
+		*step = fix16_max(fix16_smul(*step, opt->eta_minus), opt->step_min);
+		*prev = 0;
+		return 0;
+	}
+
+	if (*prev != 0) {
+		*step = fix16_min(fix16_smul(*step, opt->eta_plus), opt->step_max);
+	}
+
+	*prev = g;
+
+	return (g > 0) ? *step : -*step;
+}
+
+/* Returns the amount to add to one parameter, given its gradient (in
+ * the descent direction) summed over batch_size samples and its index
+ * in the gradient buffer */
+static fix16_t uneural_optimizer_step(struct uneural_optimizer *opt,
+                                      ssize_t k,
+                                      fix16_t sum,
+                                      uint32_t batch_size)
+{
+	fix16_t g;
+	fix16_t step;
+
+	/* The sum has the sign of the mean, but does not round to zero */
+	if (opt->type == OPTIMIZER_RPROP) {
+		return uneural_rprop_step(opt, k, sum);
+	}
+
+	g = uneural_gradient_mean(sum, batch_size);
+
+	/* SGD keeps no state, so opt->state may be NULL for it */
+	switch (opt->type) {
+	case OPTIMIZER_MOMENTUM: {
+		fix16_t *v = &opt->state[k];
+
+		/* v = mu * v + g, w += rate * v */
+		*v = fix16_sadd(fix16_smul(opt->momentum, *v), g);
+		return fix16_smul(opt->rate, *v);
+	}
+	case OPTIMIZER_NESTEROV: {
+		fix16_t *v = &opt->state[k];
+
+		/* As momentum, but stepping from the look-ahead point:
+		 * w += rate * (g + mu * v) */
+		*v = fix16_sadd(fix16_smul(opt->momentum, *v), g);
+		step = fix16_sadd(g, fix16_smul(opt->momentum, *v));
+		return fix16_smul(opt->rate, step);
+	}
+	case OPTIMIZER_ADAM: {
+		fix16_t *m = &opt->state[k];
+		fix16_t *s = &opt->state[opt->num_params + k];
+		int64_t sq = ((int64_t)g * g) >> (16 - UNEURAL_ADAM_V_SHIFT);
+		fix16_t g2 = (sq > fix16_maximum) ? fix16_maximum : (fix16_t)sq;
+
+		/* Written as x += (1 - beta) * (target - x) so the blend
+		 * rounds once */
+		*m = fix16_sadd(*m, fix16_smul(fix16_one - opt->momentum,
+					       fix16_ssub(g, *m)));
+		*s = fix16_sadd(*s, fix16_smul(fix16_one - opt->beta2,
+					       fix16_ssub(g2, *s)));
+
+		fix16_t m_hat = fix16_sdiv(*m, fix16_one - opt->beta1_pow);
+		fix16_t s_hat = fix16_sdiv(*s, fix16_one - opt->beta2_pow);
+		fix16_t rms = fix16_sqrt(s_hat) >> (UNEURAL_ADAM_V_SHIFT / 2);
+
+		step = fix16_sdiv(m_hat, fix16_sadd(rms, opt->epsilon));
+		return fix16_smul(opt->rate, step);
+	}
+	default:
+		return fix16_smul(opt->rate, g);
+	}
+}
+
+int uneural_optimizer_apply(struct uneural_optimizer *opt,
+                            struct uneural_network *n,
+                            fix16_t *grads,
+                            uint32_t batch_size)
+{
+	if (opt == NULL || n == NULL || grads == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
+	if (opt->num_params != uneural_network_gradient_count(n)) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	if (opt->type == OPTIMIZER_ADAM) {
+		opt->beta1_pow = fix16_smul(opt->beta1_pow, opt->momentum);
+		opt->beta2_pow = fix16_smul(opt->beta2_pow, opt->beta2);
+	}
+
+	ssize_t k = 0;
+
+	/* Parameters are visited in gradient buffer order: per neuron, the
+	 * bias then each input weight */
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		for (int i = 0; i < l->num_neurons; i++) {
+			struct uneural_neuron *neuron = &l->neurons[i];
+			fix16_t adj = uneural_optimizer_step(opt, k, grads[k],
+							     batch_size);
+
+			neuron->bias[0] = fix16_sadd(neuron->bias[0], adj);
+			grads[k++] = 0;
+
+			for (int j = 0; j < l->prev->num_neurons; j++) {
+				adj = uneural_optimizer_step(opt, k, grads[k],
+							     batch_size);
+				neuron->weights[j] = fix16_sadd(neuron->weights[j], adj);
+				grads[k++] = 0;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int uneural_network_train_batch(struct uneural_network *n,
+                                struct uneural_optimizer *opt,
+                                const fix16_t *inputs,
+                                const fix16_t *expected_outputs,
+                                uint32_t count,
+                                fix16_t *grads,
+                                fix16_t *scratch)
+{
+	if (n == NULL || opt == NULL || inputs == NULL ||
+	    expected_outputs == NULL || grads == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	/* Checked up front so grads are not left half accumulated */
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
+	uint16_t num_inputs = n->input->num_neurons;
+	uint16_t num_outputs = n->output->num_neurons;
+
+	for (uint32_t s = 0; s < count; s++) {
+		int res = uneural_network_compute_gradients(n,
+							    &inputs[s * num_inputs],
+							    &expected_outputs[s * num_outputs],
+							    grads, scratch, NULL);
+
+		if (res) {
+			return res;
+		}
+	}
+
+	return uneural_optimizer_apply(opt, n, grads, count);
+}
@@ -0,0 +1,209 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifndef UNEURAL_NO_THREADS
+#include <pthread.h>
+#endif
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+/* Every worker owns a private slice of the caller's scratch: context
+ * activations for its forward passes, a gradient buffer and the back
+ * propagation deltas */
+struct uneural_worker {
+	const struct uneural_network *n;
+	const fix16_t *inputs;
+	const fix16_t *expected;
+	uint32_t first;
+	uint32_t count;
+	fix16_t *acts;
+	fix16_t *grads;
+	fix16_t *deltas;
+	int result;
+#ifndef UNEURAL_NO_THREADS
+	pthread_t thread;
+	bool started;
+#endif
+};
+
+/* Rounded up to a cache line so that workers never write to the same
+ * line as each other */
+static ssize_t uneural_worker_scratch_size(struct uneural_network *n)
+{
+	ssize_t size = uneural_ctx_get_data_requirement(n);
+
+	size += uneural_network_gradient_count(n) * sizeof(fix16_t);
+	size += 3 * uneural_network_largest_layer_size(n) * sizeof(fix16_t);
+
+	return (size + UNEURAL_CACHE_LINE - 1) & ~(UNEURAL_CACHE_LINE - 1);
+}
+
+ssize_t uneural_network_get_parallel_scratch_size(struct uneural_network *n,
+                                                  uint16_t num_threads)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (num_threads == 0) {
+		num_threads = 1;
+	}
+
+	if (num_threads > UNEURAL_MAX_THREADS) {
+		num_threads = UNEURAL_MAX_THREADS;
+	}
+
+	return num_threads * uneural_worker_scratch_size(n);
+}
+
+static void *uneural_worker_run(void *arg)
+{
+	struct uneural_worker *w = arg;
+	const struct uneural_network *n = w->n;
+	struct uneural_ctx ctx;
+
+	uint16_t num_inputs = n->input->num_neurons;
+	uint16_t num_outputs = n->output->num_neurons;
+
+	w->result = uneural_ctx_init(&ctx, n, w->acts,
+				     uneural_ctx_get_data_requirement((struct uneural_network*)n));
+
+	for (uint32_t s = w->first; s < w->first + w->count; s++) {
+		if (w->result) {
+			break;
+		}
+
+		w->result = uneural_activate_network_ctx(&ctx,
+							 &w->inputs[s * num_inputs],
+							 NULL);
+		if (w->result) {
+			break;
+		}
+
+		w->result = uneural_network_accumulate_gradients(n, w->acts,
+								 &w->expected[s * num_outputs],
+								 w->grads, w->deltas,
+								 NULL);
+	}
+
+	return NULL;
+}
+
+int uneural_network_train_parallel(struct uneural_network *n,
+                                   const fix16_t *inputs,
+                                   const fix16_t *expected_outputs,
+                                   uint32_t count,
+                                   fix16_t training_rate,
+                                   uint16_t num_threads,
+                                   fix16_t *scratch)
+{
+	if (n == NULL || inputs == NULL || expected_outputs == NULL ||
+	    scratch == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
+	if (count == 0) {
+		return 0;
+	}
+
+	if (num_threads == 0) {
+		num_threads = 1;
+	}
+
+	if (num_threads > UNEURAL_MAX_THREADS) {
+		num_threads = UNEURAL_MAX_THREADS;
+	}
+
+	if (num_threads > count) {
+		num_threads = count;
+	}
+
+	struct uneural_worker workers[num_threads];
+	ssize_t slice = uneural_worker_scratch_size(n) / sizeof(fix16_t);
+	ssize_t num_grads = uneural_network_gradient_count(n);
+	ssize_t num_acts = uneural_ctx_get_data_requirement(n) / sizeof(fix16_t);
+
+	/* Contiguous, near equal shares of the batch. The split depends
+	 * only on count and num_threads, so results are reproducible */
+	for (int t = 0; t < num_threads; t++) {
+		struct uneural_worker *w = &workers[t];
+		fix16_t *base = scratch + t * slice;
+
+		w->n = n;
+		w->inputs = inputs;
+		w->expected = expected_outputs;
+		w->first = (uint64_t)count * t / num_threads;
+		w->count = (uint64_t)count * (t + 1) / num_threads - w->first;
+		w->acts = base;
+		w->grads = base + num_acts;
+		w->deltas = w->grads + num_grads;
+		w->result = 0;
+
+		memset(w->grads, 0, num_grads * sizeof(fix16_t));
+	}
+
+#ifndef UNEURAL_NO_THREADS
+	/* The calling thread takes the first share itself. A worker that
+	 * cannot be started is run inline instead */
+	for (int t = 1; t < num_threads; t++) {
+		workers[t].started = pthread_create(&workers[t].thread, NULL,
+						    uneural_worker_run,
+						    &workers[t]) == 0;
+	}
+
+	uneural_worker_run(&workers[0]);
+
+	for (int t = 1; t < num_threads; t++) {
+		if (workers[t].started) {
+			pthread_join(workers[t].thread, NULL);
+		} else {
+			uneural_worker_run(&workers[t]);
+		}
+	}
+#else
+	for (int t = 0; t < num_threads; t++) {
+		uneural_worker_run(&workers[t]);
+	}
+#endif
+
+	for (int t = 0; t < num_threads; t++) {
+		if (workers[t].result) {
+			return workers[t].result;
+		}
+	}
+
+	/* Reduce in worker order so the (saturating) sums do not depend on
+	 * which thread finished first */
+	for (int t = 1; t < num_threads; t++) {
+		fix16_vec_add(workers[0].grads, workers[0].grads,
+			      workers[t].grads, num_grads);
+	}
+
+	return uneural_network_apply_gradients(n, workers[0].grads,
+					       training_rate, count);
+}
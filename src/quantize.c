@@ -0,0 +1,312 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+#define QNETWORK_MAGIC 0x51384E55
+
+/* A quantized network is a single blob: this header, followed by one
+ * block per non-input layer. Each block is a struct uneural_qlayer,
+ * num_outputs fix16_t biases, then the int8 weight matrix (row-major,
+ * one row per neuron) padded to a multiple of 4 bytes */
+struct uneural_qnetwork_header {
+	uint32_t magic;
+	uint16_t num_layers;
+	uint16_t num_inputs;
+};
+
+struct uneural_qlayer {
+	uint16_t num_inputs;
+	uint16_t num_outputs;
+	uint32_t n_type;
+	/* Value of one weight step, so weight = q * scale */
+	fix16_t scale;
+};
+
+static ssize_t uneural_qlayer_block_size(uint16_t num_inputs,
+                                         uint16_t num_outputs)
+{
+	ssize_t weights = ((ssize_t)num_inputs * num_outputs + 3) & ~3;
+
+	return sizeof(struct uneural_qlayer) + num_outputs * sizeof(fix16_t) +
+		weights;
+}
+
+ssize_t uneural_qnetwork_get_data_requirement(struct uneural_network *n)
+{
+	ssize_t total = sizeof(struct uneural_qnetwork_header);
+
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		total += uneural_qlayer_block_size(l->prev->num_neurons,
+						   l->num_neurons);
+	}
+
+	return total;
+}
+
+/* Picks the smallest step that maps the largest weight onto +/-127 */
+static fix16_t uneural_qlayer_scale(struct uneural_layer *l)
+{
+	uint32_t max = 0;
+
+	for (int i = 0; i < l->num_neurons; i++) {
+		for (int j = 0; j < l->prev->num_neurons; j++) {
+			int64_t w = l->neurons[i].weights[j];
+			uint32_t mag = (w < 0) ? -w : w;
+
+			if (mag > max) {
+				max = mag;
+			}
+		}
+	}
+
+	if (max == 0) {
+		return 1;
+	}
+
+	return (max + 126) / 127;
+}
+
+static int8_t uneural_quantize_weight(fix16_t w, fix16_t scale)
+{
+	int64_t q;
+
+	/* Round to nearest, halves away from zero */
+	if (w >= 0) {
+		q = ((int64_t)w + scale / 2) / scale;
+	} else {
+		q = ((int64_t)w - scale / 2) / scale;
+	}
+
+	if (q > 127) {
+		return 127;
+	}
+	if (q < -127) {
+		return -127;
+	}
+	return q;
+}
+
+int uneural_qnetwork_quantize(struct uneural_network *n,
+                              uint32_t *data,
+                              ssize_t data_size)
+{
+	if (n == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	if (data_size < uneural_qnetwork_get_data_requirement(n)) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	/* Quantized layers carry a single activation type */
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		for (int i = 1; i < l->num_neurons; i++) {
+			if (*l->neurons[i].n_type != *l->neurons[0].n_type) {
+				return -MIXED_LAYER_TYPES;
+			}
+		}
+	}
+
+	struct uneural_qnetwork_header *header = (struct uneural_qnetwork_header*)data;
+	uint8_t *block = (uint8_t*)data + sizeof(*header);
+
+	header->magic = QNETWORK_MAGIC;
+	header->num_layers = 0;
+	header->num_inputs = n->input->num_neurons;
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		struct uneural_qlayer *ql = (struct uneural_qlayer*)block;
+		uint16_t num_inputs = l->prev->num_neurons;
+		fix16_t *bias = (fix16_t*)(ql + 1);
+		int8_t *weights = (int8_t*)(bias + l->num_neurons);
+
+		ql->num_inputs = num_inputs;
+		ql->num_outputs = l->num_neurons;
+		ql->n_type = *l->neurons[0].n_type;
+		ql->scale = uneural_qlayer_scale(l);
+
+		/* Biases are added to the full precision accumulator, so
+		 * there is nothing to gain from quantizing them */
+		for (int i = 0; i < l->num_neurons; i++) {
+			bias[i] = l->neurons[i].bias[0];
+
+			for (int j = 0; j < num_inputs; j++) {
+				weights[i * num_inputs + j] =
+					uneural_quantize_weight(l->neurons[i].weights[j],
+								ql->scale);
+			}
+		}
+
+		ssize_t size = uneural_qlayer_block_size(num_inputs, l->num_neurons);
+		int8_t *pad = &weights[l->num_neurons * num_inputs];
+
+		memset(pad, 0, (uint8_t*)ql + size - (uint8_t*)pad);
+
+		block += size;
+		header->num_layers++;
+	}
+
+	return 0;
+}
+
+int uneural_qnetwork_attach(struct uneural_qnetwork *q,
+                            const uint32_t *data,
+                            ssize_t data_size)
+{
+	if (q == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	const struct uneural_qnetwork_header *header =
+		(const struct uneural_qnetwork_header*)data;
+	const uint8_t *block = (const uint8_t*)data + sizeof(*header);
+	const uint8_t *end = (const uint8_t*)data + data_size;
+	uint16_t width;
+
+	if (data_size < (ssize_t)sizeof(*header)) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	if (header->magic != QNETWORK_MAGIC) {
+		return -DATA_STORAGE_UNINITIALIZED;
+	}
+
+	if (header->num_layers == 0) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	q->max_width = 0;
+	width = header->num_inputs;
+
+	/* Walk the blob once so that inference never has to bounds check */
+	for (int i = 0; i < header->num_layers; i++) {
+		const struct uneural_qlayer *ql = (const struct uneural_qlayer*)block;
+
+		if (end - block < (ssize_t)sizeof(*ql)) {
+			return -DATA_STORAGE_INSUFFICIENT;
+		}
+
+		if (ql->num_inputs != width) {
+			return -DATA_STORAGE_UNINITIALIZED;
+		}
+
+		ssize_t size = uneural_qlayer_block_size(ql->num_inputs,
+							 ql->num_outputs);
+
+		if (end - block < size) {
+			return -DATA_STORAGE_INSUFFICIENT;
+		}
+
+		width = ql->num_outputs;
+
+		if (width > q->max_width) {
+			q->max_width = width;
+		}
+
+		block += size;
+	}
+
+	q->data = data;
+	q->num_layers = header->num_layers;
+	q->num_inputs = header->num_inputs;
+	q->num_outputs = width;
+	q->act_table = NULL;
+
+	return 0;
+}
+
+ssize_t uneural_qnetwork_get_scratch_size(const struct uneural_qnetwork *q)
+{
+	if (q == NULL) {
+		return -NULL_ARG;
+	}
+
+	/* Two activation vectors, swapped between layers */
+	return 2 * q->max_width * sizeof(fix16_t);
+}
+
+/* Converts a sum of int8 * fix16 products to Q32.32 and adds the bias,
+ * saturating rather than wrapping on overflow */
+static int64_t uneural_qlayer_requantize(int64_t acc,
+                                         fix16_t scale,
+                                         fix16_t bias)
+{
+	int64_t wide;
+
+	if (__builtin_mul_overflow(acc, (int64_t)scale, &wide) ||
+	    __builtin_add_overflow(wide, (int64_t)bias << 16, &wide)) {
+		return (acc < 0) ? INT64_MIN : INT64_MAX;
+	}
+
+	return wide;
+}
+
+int uneural_qnetwork_activate(const struct uneural_qnetwork *q,
+                              const fix16_t *inputs,
+                              fix16_t *outputs,
+                              fix16_t *scratch)
+{
+	if (q == NULL || inputs == NULL || outputs == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
+
+	const uint8_t *block = (const uint8_t*)q->data +
+		sizeof(struct uneural_qnetwork_header);
+	const fix16_t *in = inputs;
+	fix16_t *out = scratch;
+
+	for (int layer = 0; layer < q->num_layers; layer++) {
+		const struct uneural_qlayer *ql = (const struct uneural_qlayer*)block;
+		const fix16_t *bias = (const fix16_t*)(ql + 1);
+		const int8_t *weights = (const int8_t*)(bias + ql->num_outputs);
+
+		if (layer == q->num_layers - 1) {
+			out = outputs;
+		}
+
+		for (int i = 0; i < ql->num_outputs; i++) {
+			int64_t acc = uneural_dot_q8(0, &weights[i * ql->num_inputs],
+						     in, ql->num_inputs);
+			fix16_t sum;
+
+			sum = uneural_wide_to_fix16(uneural_qlayer_requantize(acc,
+									     ql->scale,
+									     bias[i]));
+
+			if (uneural_activate_neuron(q->act_table, ql->n_type,
+						    sum, &out[i])) {
+				return -1;
+			}
+		}
+
+		in = out;
+		out = (out == scratch) ? &scratch[q->max_width] : scratch;
+		block += uneural_qlayer_block_size(ql->num_inputs, ql->num_outputs);
+	}
+
+	return 0;
+}
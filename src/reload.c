@@ -0,0 +1,175 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifndef UNEURAL_NO_THREADS
+#include <sched.h>
+#endif
+
+#include <uneural.h>
+
+/* Epoch based reclamation. Every reader owns a slot, on its own cache
+ * line, holding the epoch it entered in or 0 while it is outside. A
+ * publisher swaps the network pointer, starts a new epoch and waits
+ * until no slot holds an older one; any reader that entered after the
+ * swap is bound to see the new network. Readers only ever store to
+ * their own slot and load the pointer, so they never wait */
+static uint64_t *uneural_reload_slot(const struct uneural_reload *r,
+                                     uint16_t reader)
+{
+	return (uint64_t*)((uint8_t*)r->slots + reader * UNEURAL_CACHE_LINE);
+}
+
+ssize_t uneural_reload_get_slots_size(uint16_t num_readers)
+{
+	return num_readers * UNEURAL_CACHE_LINE;
+}
+
+int uneural_reload_init(struct uneural_reload *r,
+                        struct uneural_network *n,
+                        void *slots,
+                        ssize_t slots_size,
+                        uint16_t num_readers)
+{
+	if (r == NULL || n == NULL || slots == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (slots_size < uneural_reload_get_slots_size(num_readers)) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	if ((intptr_t)slots % UNEURAL_CACHE_LINE) {
+		return -DATA_STORAGE_UNALIGNED;
+	}
+
+	r->current = n;
+	r->epoch = 1;
+	r->slots = slots;
+	r->num_readers = num_readers;
+
+	for (int i = 0; i < num_readers; i++) {
+		*uneural_reload_slot(r, i) = 0;
+	}
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	return 0;
+}
+
+const struct uneural_network *uneural_reload_enter(struct uneural_reload *r,
+                                                   uint16_t reader)
+{
+	/* Slots past num_readers belong to whatever follows the array */
+	if (r == NULL || reader >= r->num_readers) {
+		return NULL;
+	}
+
+	uint64_t *slot = uneural_reload_slot(r, reader);
+
+	__atomic_store_n(slot, __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST),
+			 __ATOMIC_SEQ_CST);
+
+	return __atomic_load_n(&r->current, __ATOMIC_SEQ_CST);
+}
+
+int uneural_reload_exit(struct uneural_reload *r, uint16_t reader)
+{
+	if (r == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (reader >= r->num_readers) {
+		return -RELOAD_BAD_READER;
+	}
+
+	__atomic_store_n(uneural_reload_slot(r, reader), 0, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+int uneural_reload_activate(struct uneural_reload *r,
+                            uint16_t reader,
+                            fix16_t *activations,
+                            ssize_t activations_size,
+                            const fix16_t *inputs,
+                            fix16_t *outputs)
+{
+	if (r == NULL || activations == NULL || inputs == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (reader >= r->num_readers) {
+		return -RELOAD_BAD_READER;
+	}
+
+	struct uneural_ctx ctx;
+	const struct uneural_network *n = uneural_reload_enter(r, reader);
+	int res = uneural_ctx_init(&ctx, n, activations, activations_size);
+
+	if (res == 0) {
+		res = uneural_activate_network_ctx(&ctx, inputs, outputs);
+	}
+
+	uneural_reload_exit(r, reader);
+
+	return res;
+}
+
+int uneural_reload_publish(struct uneural_reload *r,
+                           struct uneural_network *n,
+                           struct uneural_network **old)
+{
+	if (r == NULL || n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	struct uneural_network *prev = r->current;
+
+	/* Callers feed the same inputs and expect the same outputs from
+	 * whichever network they get */
+	if (n->input->num_neurons != prev->input->num_neurons ||
+	    n->output->num_neurons != prev->output->num_neurons) {
+		return -RELOAD_SHAPE_MISMATCH;
+	}
+
+	__atomic_store_n(&r->current, n, __ATOMIC_SEQ_CST);
+
+	uint64_t epoch = __atomic_add_fetch(&r->epoch, 1, __ATOMIC_SEQ_CST);
+
+	/* Grace period: wait out every reader that may still hold prev */
+	for (int i = 0; i < r->num_readers; i++) {
+		uint64_t *slot = uneural_reload_slot(r, i);
+
+		for (;;) {
+			uint64_t seen = __atomic_load_n(slot, __ATOMIC_SEQ_CST);
+
+			if (seen == 0 || seen >= epoch) {
+				break;
+			}
+#ifndef UNEURAL_NO_THREADS
+			sched_yield();
+#endif
+		}
+	}
+
+	if (old != NULL) {
+		*old = prev;
+	}
+
+	return 0;
+}
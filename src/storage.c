@@ -29,6 +29,52 @@ int uneural_network_init_storage(fix16_t *net_data,
 	return 0;
 }
 
+static ssize_t uneural_align_line(ssize_t size)
+{
+	return (size + UNEURAL_CACHE_LINE - 1) & ~(ssize_t)(UNEURAL_CACHE_LINE - 1);
+}
+
+static ssize_t uneural_layer_block_size(struct uneural_layer *l)
+{
+	/* Activation descriptor, bias vector and weight matrix each start
+	 * on their own cache line */
+	return (uneural_align_line(sizeof(uint32_t)) +
+		uneural_align_line(l->num_neurons * sizeof(fix16_t)) +
+		uneural_align_line(l->num_neurons * l->prev->num_neurons *
+				   sizeof(fix16_t)));
+}
+
+int uneural_network_set_storage_layout(struct uneural_network *n,
+                                       enum storage_layout layout)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	/* The layout determines where every pointer lands, so it can't
+	 * be changed underneath attached storage */
+	if (n->storage_attached) {
+		return -DATA_STORAGE_ATTACHED;
+	}
+
+	n->layout = layout;
+
+	return 0;
+}
+
+static ssize_t uneural_network_get_layer_data_requirement(struct uneural_network *n)
+{
+	/* The keyword gets a full cache line so that the first layer
+	 * block is aligned as well */
+	ssize_t total_required = uneural_align_line(sizeof(uint32_t));
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		total_required += uneural_layer_block_size(l);
+	}
+
+	return total_required;
+}
+
 ssize_t uneural_network_get_data_requirement(struct uneural_network *n)
 {
 	/* All non-input neurons require bias + (NUM_INPUTS * weights) bytes of word
@@ -48,6 +94,10 @@ ssize_t uneural_network_get_data_requirement(struct uneural_network *n)
 		return -MISSING_INPUT_LAYER;
 	}
 
+	if (n->layout == STORAGE_LAYOUT_LAYER) {
+		return uneural_network_get_layer_data_requirement(n);
+	}
+
 	/* We skip the input layer as no bias or weight are required */
 	struct uneural_layer *l = n->input->next;
 
@@ -63,10 +113,81 @@ ssize_t uneural_network_get_data_requirement(struct uneural_network *n)
 	return total_required;
 }
 
+static int uneural_network_layer_data_attach(struct uneural_network *n,
+                                             fix16_t *data,
+                                             ssize_t data_size)
+{
+	uint8_t *block = (uint8_t*)data;
+
+	/* Every block is placed on a cache line boundary relative to the
+	 * start of storage, so the storage itself must be line aligned */
+	if ((intptr_t)data % UNEURAL_CACHE_LINE) {
+		return -DATA_STORAGE_UNALIGNED;
+	}
+
+	if (uneural_network_validate_storage(data) != 0) {
+		return -DATA_STORAGE_UNINITIALIZED;
+	}
+
+	if (data_size < uneural_network_get_layer_data_requirement(n)) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	block += uneural_align_line(sizeof(uint32_t));
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		uint16_t num_inputs = l->prev->num_neurons;
+
+		if (l->neurons == NULL) {
+			return -MISSING_NEURON;
+		}
+
+		l->n_type = (uint32_t*)block;
+		block += uneural_align_line(sizeof(uint32_t));
+		l->bias = (fix16_t*)block;
+		block += uneural_align_line(l->num_neurons * sizeof(fix16_t));
+		l->weights = (fix16_t*)block;
+		block += uneural_align_line(l->num_neurons * num_inputs *
+					    sizeof(fix16_t));
+
+		/* Keep the per-neuron API working by pointing each neuron
+		 * at its slice of the layer's storage. All neurons of a
+		 * layer share the layer's activation descriptor */
+		for (int i = 0; i < l->num_neurons; i++) {
+			l->neurons[i].n_type = l->n_type;
+			l->neurons[i].bias = &l->bias[i];
+			l->neurons[i].weights = &l->weights[i * num_inputs];
+		}
+	}
+
+	n->storage_attached = true;
+	n->storage = data;
+	n->storage_size = uneural_network_get_layer_data_requirement(n);
+
+	return 0;
+}
+
 int uneural_network_data_attach(struct uneural_network *n,
                                 fix16_t *data,
                                 ssize_t data_size)
 {
+	if (n == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	n->storage_read_only = false;
+
+	for (struct uneural_layer *l = n->input; l != NULL; l = l->next) {
+		l->storage_read_only = false;
+	}
+
+	if (n->layout == STORAGE_LAYOUT_LAYER) {
+		return uneural_network_layer_data_attach(n, data, data_size);
+	}
 
 	fix16_t *start_addr = data;
 
@@ -95,6 +216,10 @@ int uneural_network_data_attach(struct uneural_network *n,
 			return -MISSING_NEURON;
 		}
 
+		l->n_type = NULL;
+		l->bias = NULL;
+		l->weights = NULL;
+
 		/* Walk the neurons individually and assign them weight and
 		 * bias storage */
 		for(int i = 0; i < l->num_neurons; i++) {
@@ -111,6 +236,8 @@ int uneural_network_data_attach(struct uneural_network *n,
 	}
 
 	n->storage_attached = true;
+	n->storage = start_addr;
+	n->storage_size = (data - start_addr) * sizeof(fix16_t);
 
 	/* Calculate the size of the required network data buffer */
 	if (data_size < (intptr_t)(data - start_addr)) {
@@ -118,3 +245,24 @@ int uneural_network_data_attach(struct uneural_network *n,
 	}
 	return 0;
 }
+
+int uneural_network_data_attach_const(struct uneural_network *n,
+                                      const fix16_t *data,
+                                      ssize_t data_size)
+{
+	/* Attaching only reads the storage. The neurons' pointers are not
+	 * const, but nothing writes through them once the network is
+	 * flagged read only */
+	int res = uneural_network_data_attach(n, (fix16_t*)data, data_size);
+
+	if (res == 0) {
+		n->storage_read_only = true;
+
+		/* uneural_network_set_layer_type only sees the layer */
+		for (struct uneural_layer *l = n->input; l != NULL; l = l->next) {
+			l->storage_read_only = true;
+		}
+	}
+
+	return res;
+}
@@ -0,0 +1,346 @@
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include <uneural.h>
+#include <uneural_internal.h>
+
+/* Scratch layout: backprop deltas, the gradient buffer, then the sample
+ * order */
+static ssize_t uneural_train_deltas_size(struct uneural_network *n)
+{
+	return uneural_network_get_training_scratch_size(n);
+}
+
+ssize_t uneural_train_get_scratch_size(struct uneural_network *n,
+                                       const struct uneural_dataset *data)
+{
+	if (n == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	return uneural_train_deltas_size(n) +
+		uneural_network_get_gradient_size(n) +
+		data->count * sizeof(uint32_t);
+}
+
+/* xorshift32, plenty for shuffling and reproducible everywhere */
+static uint32_t uneural_train_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+static void uneural_train_shuffle(uint32_t *order,
+                                  uint32_t count,
+                                  uint32_t *state)
+{
+	/* Fisher-Yates */
+	for (uint32_t i = count - 1; i > 0; i--) {
+		uint32_t j = uneural_train_rand(state) % (i + 1);
+		uint32_t swap = order[i];
+
+		order[i] = order[j];
+		order[j] = swap;
+	}
+}
+
+static int uneural_train_check_dataset(struct uneural_network *n,
+                                       const struct uneural_dataset *data)
+{
+	if (data->inputs == NULL && data->get == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (data->inputs != NULL && data->targets == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	/* Samples are read at the network's widths, so a dataset with
+	 * narrower rows would be read past its end */
+	if ((data->input_width && data->input_width != n->input->num_neurons) ||
+	    (data->target_width && data->target_width != n->output->num_neurons)) {
+		return -DATASET_SHAPE_MISMATCH;
+	}
+
+	return 0;
+}
+
+static int uneural_train_sample(const struct uneural_dataset *data,
+                                uint16_t num_inputs,
+                                uint16_t num_outputs,
+                                uint32_t index,
+                                const fix16_t **input,
+                                const fix16_t **target)
+{
+	if (data->inputs == NULL) {
+		return data->get(data->arg, index, input, target);
+	}
+
+	size_t input_stride = data->input_stride ? data->input_stride : num_inputs;
+	size_t target_stride = data->target_stride ? data->target_stride : num_outputs;
+
+	*input = &data->inputs[index * input_stride];
+	*target = &data->targets[index * target_stride];
+
+	return 0;
+}
+
+static void uneural_train_prefetch(const struct uneural_dataset *data,
+                                   uint16_t num_inputs,
+                                   uint16_t num_outputs,
+                                   uint32_t index)
+{
+#ifdef __GNUC__
+	const fix16_t *input;
+	const fix16_t *target;
+
+	/* Only arrays can be looked up without side effects */
+	if (data->inputs != NULL) {
+		uneural_train_sample(data, num_inputs, num_outputs, index,
+				     &input, &target);
+		__builtin_prefetch(input);
+		__builtin_prefetch(target);
+	}
+#endif
+}
+
+/* Squares are summed in Q40.24 so that errors too small to square in
+ * fix16 still count towards the loss */
+static void uneural_train_add_squares(int64_t *sum,
+                                      const fix16_t *error,
+                                      uint16_t count)
+{
+	for (int i = 0; i < count; i++) {
+		int64_t sq = ((int64_t)error[i] * error[i]) >> 8;
+
+		if (*sum > INT64_MAX - sq) {
+			*sum = INT64_MAX;
+		} else {
+			*sum += sq;
+		}
+	}
+}
+
+/* Mean squared error over every output of every sample */
+static fix16_t uneural_train_mse(int64_t sum,
+                                 uint32_t count,
+                                 uint16_t num_outputs)
+{
+	int64_t mse = (sum / ((int64_t)count * num_outputs)) >> 8;
+
+	return (mse > fix16_maximum) ? fix16_maximum : (fix16_t)mse;
+}
+
+int uneural_train_epochs(struct uneural_network *n,
+                         const struct uneural_dataset *data,
+                         const struct uneural_train_params *params,
+                         void *scratch,
+                         fix16_t *epoch_loss,
+                         uint32_t *epochs_run)
+{
+	if (n == NULL || data == NULL || params == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
+
+	int res = uneural_train_check_dataset(n, data);
+
+	if (res) {
+		return res;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
+	uint16_t num_inputs = n->input->num_neurons;
+	uint16_t num_outputs = n->output->num_neurons;
+	uint32_t batch_size = params->batch_size ? params->batch_size : 1;
+	ssize_t grads_size = uneural_network_get_gradient_size(n);
+	fix16_t *deltas = scratch;
+	fix16_t *grads = (fix16_t*)((uint8_t*)scratch + uneural_train_deltas_size(n));
+	uint32_t *order = (uint32_t*)((uint8_t*)grads + grads_size);
+	uint32_t rng = params->shuffle_seed;
+	fix16_t best_loss = fix16_maximum;
+	uint32_t since_best = 0;
+	uint32_t epoch;
+	fix16_t error[num_outputs];
+
+	/* Per sample SGD goes straight through backprop, anything else
+	 * accumulates gradients */
+	bool direct = (batch_size == 1 && params->opt == NULL);
+
+	memset(grads, 0, grads_size);
+
+	for (uint32_t i = 0; i < data->count; i++) {
+		order[i] = i;
+	}
+
+	if (epochs_run != NULL) {
+		*epochs_run = 0;
+	}
+
+	if (data->count == 0) {
+		return 0;
+	}
+
+	for (epoch = 0; epoch < params->epochs; epoch++) {
+		int64_t squared_error = 0;
+		uint32_t pending = 0;
+
+		if (params->shuffle_seed != 0) {
+			uneural_train_shuffle(order, data->count, &rng);
+		}
+
+		for (uint32_t s = 0; s < data->count; s++) {
+			const fix16_t *input;
+			const fix16_t *target;
+
+			if (s + 1 < data->count) {
+				uneural_train_prefetch(data, num_inputs, num_outputs,
+						       order[s + 1]);
+			}
+
+			res = uneural_train_sample(data, num_inputs, num_outputs,
+						   order[s], &input, &target);
+			if (res) {
+				return res;
+			}
+
+			if (direct) {
+				res = uneural_network_backprop(n, input, target,
+							       params->rate, deltas,
+							       error);
+			} else {
+				res = uneural_network_compute_gradients(n, input, target,
+									grads, deltas,
+									error);
+			}
+
+			if (res) {
+				return res;
+			}
+
+			uneural_train_add_squares(&squared_error, error, num_outputs);
+
+			if (!direct && (++pending == batch_size || s + 1 == data->count)) {
+				if (params->opt != NULL) {
+					res = uneural_optimizer_apply(params->opt, n,
+								      grads, pending);
+				} else {
+					res = uneural_network_apply_gradients(n, grads,
+									      params->rate,
+									      pending);
+				}
+
+				if (res) {
+					return res;
+				}
+
+				pending = 0;
+			}
+		}
+
+		/* Measured before each sample's update */
+		fix16_t loss = uneural_train_mse(squared_error, data->count,
+						 num_outputs);
+
+		if (epoch_loss != NULL) {
+			epoch_loss[epoch] = loss;
+		}
+
+		if (loss <= params->target_loss) {
+			epoch++;
+			break;
+		}
+
+		if (loss < best_loss) {
+			best_loss = loss;
+			since_best = 0;
+		} else if (params->patience != 0 && ++since_best >= params->patience) {
+			epoch++;
+			break;
+		}
+	}
+
+	if (epochs_run != NULL) {
+		*epochs_run = epoch;
+	}
+
+	return 0;
+}
+
+int uneural_network_evaluate(struct uneural_network *n,
+                             const struct uneural_dataset *data,
+                             fix16_t *mse)
+{
+	if (n == NULL || data == NULL || mse == NULL) {
+		return -NULL_ARG;
+	}
+
+	int res = uneural_train_check_dataset(n, data);
+
+	if (res) {
+		return res;
+	}
+
+	uint16_t num_inputs = n->input->num_neurons;
+	uint16_t num_outputs = n->output->num_neurons;
+	fix16_t outputs[num_outputs];
+	int64_t squared_error = 0;
+
+	*mse = 0;
+
+	for (uint32_t s = 0; s < data->count; s++) {
+		const fix16_t *input;
+		const fix16_t *target;
+
+		if (s + 1 < data->count) {
+			uneural_train_prefetch(data, num_inputs, num_outputs, s + 1);
+		}
+
+		res = uneural_train_sample(data, num_inputs, num_outputs, s,
+					   &input, &target);
+		if (res) {
+			return res;
+		}
+
+		res = uneural_activate_network(n, input, outputs);
+		if (res) {
+			return res;
+		}
+
+		fix16_vec_sub(outputs, target, outputs, num_outputs);
+
+		uneural_train_add_squares(&squared_error, outputs, num_outputs);
+	}
+
+	if (data->count != 0) {
+		*mse = uneural_train_mse(squared_error, data->count, num_outputs);
+	}
+
+	return 0;
+}
@@ -3,6 +3,7 @@
 #include <stdio.h>
 
 #include <uneural.h>
+#include <uneural_internal.h>
 //#define DEBUG
 
 #ifdef DEBUG
@@ -69,6 +70,217 @@ uint16_t uneural_network_largest_layer_size(struct uneural_network *n)
 	return max_layer_size;
 }
 
+static fix16_t uneural_neuron_deriv(uint32_t n_type, fix16_t v)
+{
+	switch (n_type) {
+	case NEURON_TYPE_SIGMOID:
+		return uneural_sigmoid_deriv(v);
+	case NEURON_TYPE_TANH:
+		return uneural_tanh_deriv(v);
+	case NEURON_TYPE_RELU:
+		return uneural_relu_deriv(v);
+	case NEURON_TYPE_LEAKY_RELU:
+		return uneural_leaky_relu_deriv(v);
+	}
+
+	return 0;
+}
+
+ssize_t uneural_network_gradient_count(const struct uneural_network *n)
+{
+	ssize_t count = 0;
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		count += l->num_neurons * (l->prev->num_neurons + 1);
+	}
+
+	return count;
+}
+
+/* Neuron outputs come from a context's activations when given, from the
+ * network's own neurons otherwise */
+static inline fix16_t uneural_layer_output(const struct uneural_layer *l,
+                                           const fix16_t *acts,
+                                           int i)
+{
+	if (acts != NULL) {
+		return acts[i];
+	}
+	return l->neurons[i].output;
+}
+
+int uneural_network_accumulate_gradients(const struct uneural_network *n,
+                                         const fix16_t *acts,
+                                         const fix16_t *expected_output,
+                                         fix16_t *grads,
+                                         fix16_t *deltas,
+                                         fix16_t *output_error)
+{
+	struct uneural_network *net = (struct uneural_network*)n;
+	uint16_t max_layer_size = uneural_network_largest_layer_size(net);
+	fix16_t *delta = deltas;
+	fix16_t *next_delta = deltas + max_layer_size;
+	fix16_t *gathered = deltas + 2 * max_layer_size;
+	const fix16_t *out = NULL;
+	fix16_t *grad = grads + uneural_network_gradient_count(n);
+
+	if (acts != NULL) {
+		ssize_t total = uneural_ctx_get_data_requirement(net);
+
+		out = acts + total / sizeof(fix16_t) - n->output->num_neurons;
+	}
+
+	for (struct uneural_layer *l = n->output; l != n->input; l = l->prev) {
+		struct uneural_layer *l_p = l->prev;
+		struct uneural_layer *l_n = l->next;
+		const fix16_t *prev_out = (out != NULL) ? out - l_p->num_neurons : NULL;
+
+		if (l == n->output) {
+			for (int i = 0; i < l->num_neurons; i++) {
+				delta[i] = fix16_ssub(expected_output[i],
+						      uneural_layer_output(l, out, i));
+				if (output_error != NULL) {
+					output_error[i] = delta[i];
+				}
+			}
+		} else {
+			/* Back propagate error from the next layer, whose
+			 * weights have not been touched yet. Each of its
+			 * neurons adds its share to every error at once, in
+			 * the same order as summing each error in turn */
+			memset(delta, 0, l->num_neurons * sizeof(fix16_t));
+
+			for (int j = 0; j < l_n->num_neurons; j++) {
+				fix16_vec_axpy(delta, next_delta[j],
+					       uneural_layer_weights(l_n, j),
+					       l->num_neurons);
+			}
+		}
+
+		for (int i = 0; i < l->num_neurons; i++) {
+			fix16_t v = uneural_layer_output(l, out, i);
+
+			delta[i] = fix16_smul(delta[i],
+					      uneural_neuron_deriv(uneural_layer_type(l, i), v));
+		}
+
+		/* The neurons' own outputs are not contiguous */
+		if (prev_out == NULL) {
+			for (int j = 0; j < l_p->num_neurons; j++) {
+				gathered[j] = l_p->neurons[j].output;
+			}
+		}
+
+		/* Gradients are stored per layer, per neuron as the bias
+		 * followed by one entry per input */
+		grad -= l->num_neurons * (l_p->num_neurons + 1);
+
+		for (int i = 0; i < l->num_neurons; i++) {
+			fix16_t *row = &grad[i * (l_p->num_neurons + 1)];
+
+			row[0] = fix16_sadd(row[0], delta[i]);
+			fix16_vec_axpy(&row[1], delta[i],
+				       (prev_out != NULL) ? prev_out : gathered,
+				       l_p->num_neurons);
+		}
+
+		fix16_t *swap = delta;
+		delta = next_delta;
+		next_delta = swap;
+		out = prev_out;
+	}
+
+	return 0;
+}
+
+ssize_t uneural_network_get_gradient_size(struct uneural_network *n)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	return uneural_network_gradient_count(n) * sizeof(fix16_t);
+}
+
+int uneural_network_compute_gradients(struct uneural_network *n,
+                                      const fix16_t *input,
+                                      const fix16_t *expected_output,
+                                      fix16_t *grads,
+                                      fix16_t *scratch,
+                                      fix16_t *output_error)
+{
+	if (n == NULL || input == NULL || expected_output == NULL ||
+	    grads == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
+
+	int res = uneural_activate_network(n, input, NULL);
+
+	if (res) {
+		return res;
+	}
+
+	return uneural_network_accumulate_gradients(n, NULL, expected_output,
+						    grads, scratch, output_error);
+}
+
+int uneural_network_apply_gradients(struct uneural_network *n,
+                                    fix16_t *grads,
+                                    fix16_t training_rate,
+                                    uint32_t batch_size)
+{
+	if (n == NULL || grads == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->storage_attached == false) {
+		return -MISSING_DATA_STORAGE;
+	}
+
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
+	for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		uint16_t num_inputs = l->prev->num_neurons;
+
+		for (int i = 0; i < l->num_neurons; i++) {
+			fix16_t *row = &grads[i * (num_inputs + 1)];
+			fix16_t adj;
+
+			/* The means are taken in place, then the whole row is
+			 * stepped at once */
+			if (batch_size > 1) {
+				for (int j = 0; j < num_inputs; j++) {
+					row[j + 1] = uneural_gradient_mean(row[j + 1],
+									   batch_size);
+				}
+			}
+
+			fix16_vec_axpy(l->neurons[i].weights, training_rate,
+				       &row[1], num_inputs);
+			memset(&row[1], 0, num_inputs * sizeof(fix16_t));
+
+			adj = fix16_smul(uneural_gradient_mean(row[0], batch_size),
+					 training_rate);
+			l->neurons[i].bias[0] = fix16_sadd(l->neurons[i].bias[0], adj);
+			row[0] = 0;
+		}
+
+		grads += l->num_neurons * (num_inputs + 1);
+	}
+
+	return 0;
+}
+
 ssize_t uneural_network_get_training_scratch_size(struct uneural_network *n)
 {
 
@@ -78,7 +290,11 @@ ssize_t uneural_network_get_training_scratch_size(struct uneural_network *n)
 
 	uint16_t max_layer_size = uneural_network_largest_layer_size(n);
 
-	return (max_layer_size * max_layer_size) * 8 * sizeof(fix16_t);
+	/* Backprop only ever holds the deltas of two adjacent layers (the
+	 * layer being updated and the one before it), plus the previous
+	 * layer's outputs gathered into an array and the adjustments made
+	 * from them */
+	return 4 * max_layer_size * sizeof(fix16_t);
 }
 
 void print_network_neurons(struct uneural_network *n)
@@ -120,172 +336,158 @@ void print_network_neurons(struct uneural_network *n)
 
 }
 
-/* TODO: Add size check to inputs and outputs */
-int uneural_network_backprop(struct uneural_network *n,
-                             const fix16_t *input,
-                             const fix16_t *expected_output,
-                             fix16_t training_rate,
-                             fix16_t *scratch,
-                             fix16_t *output_error)
+/* Updates the weights from the neuron outputs left by the last forward
+ * pass */
+static int uneural_network_backprop_outputs(struct uneural_network *n,
+                                            const fix16_t *expected_output,
+                                            fix16_t training_rate,
+                                            fix16_t *scratch,
+                                            fix16_t *output_error)
 {
-
-	if (n == NULL || input == NULL ||
-	    expected_output == NULL || scratch == NULL) {
-		return -NULL_ARG;
-	}
-
-	int res = uneural_activate_network(n,
-					   input,
-					   NULL);
-
-	if (res) {
-		DEBUG_PRINT("Error activating network\n");
-		return res;
-	}
-
-	uint32_t max_layer_size = uneural_network_largest_layer_size(n);
-	uint32_t step_size = (max_layer_size * max_layer_size);
-
-	fix16_t *l1_output = scratch;
-	fix16_t *l1_error = l1_output + step_size;
-	fix16_t *l1_delta = l1_error + step_size;
-	fix16_t *l1_start_weight = l1_delta + step_size;
-	fix16_t *l2_output = l1_start_weight + step_size;
-	fix16_t *l2_error = l2_output + step_size;
-	fix16_t *l2_delta = l2_error + step_size;
-	fix16_t *l2_start_weight = l2_delta + step_size;
+	uint16_t max_layer_size = uneural_network_largest_layer_size(n);
+	fix16_t *delta = scratch;
+	fix16_t *prev_delta = scratch + max_layer_size;
+	fix16_t *prev_out = scratch + 2 * max_layer_size;
+	fix16_t *adj = scratch + 3 * max_layer_size;
 
 #ifdef DEBUG
 	print_network_neurons(n);
 #endif
 
+	for (int i = 0; i < n->output->num_neurons; i++) {
+		struct uneural_neuron *neuron = &n->output->neurons[i];
+		fix16_t err = fix16_ssub(expected_output[i], neuron->output);
+
+		if (output_error != NULL) {
+			output_error[i] = err;
+		}
+
+		delta[i] = fix16_smul(err, uneural_neuron_deriv(*neuron->n_type,
+								neuron->output));
+	}
+
 	for (struct uneural_layer *l = n->output; l != n->input; l = l->prev) {
 		struct uneural_layer *l_p = l->prev;
-		struct uneural_layer *l_n = l->next;
 
-		if (l == n->output) {
-			DEBUG_PRINT("Output Layer\n");
+		/* Back propagate the error into the previous layer while this
+		 * layer's weights are still the ones used in the forward pass */
+		if (l_p != n->input) {
+			/* Row by row through the weights, which sums every
+			 * error in the same order as one at a time would */
+			memset(prev_delta, 0, l_p->num_neurons * sizeof(fix16_t));
+
 			for (int i = 0; i < l->num_neurons; i++) {
+				fix16_vec_axpy(prev_delta, delta[i],
+					       l->neurons[i].weights, l_p->num_neurons);
+			}
 
-				/* Copy in the initial weights */
-				for (int j = 0; j < l_p->num_neurons; j++) {
-					l2_start_weight[l->num_neurons * i + j] = l->neurons[i].weights[j];
-					l1_output[j] = l_p->neurons[j].output;
-					DEBUG_PRINT("[%d|%d]w: %f\n", i, j,
-						    fix16_to_float(l2_start_weight[l->num_neurons * i + j]));
+			for (int j = 0; j < l_p->num_neurons; j++) {
+				DEBUG_PRINT("[%d] err sum: %f\n", j,
+					    fix16_to_float(prev_delta[j]));
+				prev_delta[j] = fix16_smul(prev_delta[j],
+							   uneural_neuron_deriv(*l_p->neurons[j].n_type,
+										l_p->neurons[j].output));
+			}
+		}
 
-				}
+		for (int j = 0; j < l_p->num_neurons; j++) {
+			prev_out[j] = l_p->neurons[j].output;
+		}
 
-				l2_output[i] = l->neurons[i].output;
-				l2_error[i] = fix16_ssub(expected_output[i],
-							 l->neurons[i].output);
-
-				output_error[i] = l2_error[i];
-
-				fix16_t deriv = 0;
-
-				switch (*l->neurons[i].n_type) {
-				case NEURON_TYPE_SIGMOID:
-					deriv = uneural_sigmoid_deriv(l2_output[i]);
-					break;
-				case NEURON_TYPE_TANH:
-					deriv = uneural_tanh_deriv(l2_output[i]);
-					break;
-				case NEURON_TYPE_RELU:
-					deriv = uneural_relu_deriv(l2_output[i]);
-					break;
-				case NEURON_TYPE_LEAKY_RELU:
-					deriv = uneural_leaky_relu_deriv(l2_output[i]);
-					break;
-				}
+		/* Update working layer weights. This is plain SGD, for
+		 * momentum, Nesterov or Adam accumulate gradients with
+		 * uneural_network_compute_gradients and apply them through
+		 * uneural_optimizer_apply */
+		for (int i = 0; i < l->num_neurons; i++) {
+			fix16_vec_scale(adj, prev_out, delta[i], l_p->num_neurons);
+			fix16_vec_axpy(l->neurons[i].weights, training_rate, adj,
+				       l_p->num_neurons);
 
-				l2_delta[i] = fix16_smul(l2_error[i], deriv);
-				DEBUG_PRINT("[%d]o/d: %f/%f\n", i,
-					    fix16_to_float(l2_output[i]),
-					    fix16_to_float(l2_delta[i]));
-			}
+			/* Adjust the neuron's bias */
+			fix16_t bias_adj = fix16_smul(delta[i], training_rate);
+			l->neurons[i].bias[0] = fix16_sadd(l->neurons[i].bias[0], bias_adj);
+			DEBUG_PRINT("[%d] delta/bias adjust: %f/%f\n", i,
+				    fix16_to_float(delta[i]),
+				    fix16_to_float(bias_adj));
+		}
 
-		} else {
-			DEBUG_PRINT("Hidden Layer\n");
-			for (int i = 0; i < l->num_neurons; i++) {
-				fix16_t sum = F16(0);
+		fix16_t *swap = delta;
+		delta = prev_delta;
+		prev_delta = swap;
+	}
+	return 0;
+}
 
-				/* Copy in the initial weights */
-				for (int j = 0; j < l_p->num_neurons; j++) {
-					l2_start_weight[l->num_neurons * i + j] = l->neurons[i].weights[j];
-				}
+/* TODO: Add size check to inputs and outputs */
+int uneural_network_backprop(struct uneural_network *n,
+                             const fix16_t *input,
+                             const fix16_t *expected_output,
+                             fix16_t training_rate,
+                             fix16_t *scratch,
+                             fix16_t *output_error)
+{
+	return uneural_network_infer_and_learn(n, input, expected_output,
+					       training_rate, scratch,
+					       NULL, output_error);
+}
 
-				/* Back propegate error from next layer */
-				for (int j = 0; j < l_n->num_neurons; j++) {
-					DEBUG_PRINT("%d:%d - ", i, j);
+int uneural_network_backprop_cached(struct uneural_network *n,
+                                    const fix16_t *expected_output,
+                                    fix16_t training_rate,
+                                    fix16_t *scratch,
+                                    fix16_t *output_error)
+{
+	if (n == NULL || expected_output == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
 
-					fix16_t temp = fix16_smul(l1_delta[j],
-								  l1_start_weight[l_n->num_neurons * j + i]);
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
 
-					DEBUG_PRINT("d/w/e: %f/%f/%f\n",
-						    fix16_to_float(l1_delta[j]),
-						    fix16_to_float(l1_start_weight[l_n->num_neurons * j + i]),
-						    fix16_to_float(temp));
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
 
-					sum  = fix16_sadd(sum, temp);
-					DEBUG_PRINT("Err Sum: %f\n", fix16_to_float(sum));
-				}
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
 
-				l2_output[i] = l->neurons[i].output;
-				fix16_t deriv = 0;
-
-				switch (*l->neurons[i].n_type) {
-				case NEURON_TYPE_SIGMOID:
-					deriv = uneural_sigmoid_deriv(l2_output[i]);
-					break;
-				case NEURON_TYPE_TANH:
-					deriv = uneural_tanh_deriv(l2_output[i]);
-					break;
-				case NEURON_TYPE_RELU:
-					deriv = uneural_relu_deriv(l2_output[i]);
-					break;
-				case NEURON_TYPE_LEAKY_RELU:
-					deriv = uneural_leaky_relu_deriv(l2_output[i]);
-					break;
-				}
-				deriv = fix16_smul(sum, deriv);
+	return uneural_network_backprop_outputs(n, expected_output,
+						training_rate, scratch,
+						output_error);
+}
 
-				l2_delta[i] = deriv;
-				DEBUG_PRINT("l2 delta%f \n", fix16_to_float(l2_delta[i]));
-				DEBUG_PRINT("--------------------\n");
-			}
-		}
+int uneural_network_infer_and_learn(struct uneural_network *n,
+                                    const fix16_t *input,
+                                    const fix16_t *expected_output,
+                                    fix16_t training_rate,
+                                    fix16_t *scratch,
+                                    fix16_t *outputs,
+                                    fix16_t *output_error)
+{
+	if (n == NULL || input == NULL ||
+	    expected_output == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
 
-		/* Update working layer weights */
-		/* TODO: Add alpha/momentum term */
-		//DEBUG_PRINT("Updating layer weights\n");
-		for (int i = 0; i < l->num_neurons; i++) {
-			for (int j = 0; j < l_p->num_neurons; j++) {
-				fix16_t layer_adj = fix16_smul(l2_delta[i],
-							       l_p->neurons[j].output);
-
-				layer_adj = fix16_smul(layer_adj,
-						       training_rate);
-				DEBUG_PRINT("[%d, %d] error/adj: %f|%f\n", i, j,
-					    fix16_to_float(l2_error[i]),
-					    fix16_to_float(layer_adj));
-				l->neurons[i].weights[j] = fix16_sadd(l->neurons[i].weights[j],
-								      layer_adj);
-			}
-			/* Adjust the neuron's bias */
-			fix16_t bias_adj = l2_delta[i];
-			bias_adj = fix16_smul(bias_adj, training_rate);
-			l->neurons[i].bias[0] = fix16_sadd(l->neurons[i].bias[0], bias_adj);
-			DEBUG_PRINT("Bias adjust: %f\n",
-				    fix16_to_float(bias_adj));
-		}
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
+	/* outputs receive the prediction made before the update */
+	int res = uneural_activate_network(n,
+					   input,
+					   outputs);
 
-		memcpy(l1_output,       l2_output, step_size);
-		memcpy(l1_error,        l2_error, step_size);
-		memcpy(l1_delta,        l2_delta, step_size);
-		memcpy(l1_start_weight, l2_start_weight, step_size);
+	if (res) {
+		DEBUG_PRINT("Error activating network\n");
+		return res;
 	}
-	return 0;
+
+	return uneural_network_backprop_outputs(n, expected_output,
+						training_rate, scratch,
+						output_error);
 }
 
 int uneural_network_randomize_weights(struct uneural_network *n)
@@ -298,6 +500,10 @@ int uneural_network_randomize_weights(struct uneural_network *n)
 		return -MISSING_DATA_STORAGE;
 	}
 
+	if (n->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
 	/* We skip the input layer as no bias or weight are required, it
 	 * exists simply as a programming convenience */
 	struct uneural_layer *l = n->input->next;
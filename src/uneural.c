@@ -6,6 +6,7 @@
 #include <stdio.h>
 
 #include <uneural.h>
+#include <uneural_internal.h>
 
 
 fix16_t uneural_activate_sigmoid(fix16_t sum)
@@ -53,51 +54,98 @@ fix16_t uneural_activate_leaky_relu(fix16_t sum)
 	return fix16_max(lh_arg, sum);
 }
 
-int uneural_activate_layer(struct uneural_layer *work_layer)
+int uneural_activate_neuron(const struct uneural_activation_table *t,
+                            uint32_t n_type,
+                            fix16_t sum,
+                            fix16_t *output)
+{
+	/* Fire the correct activation function for the neuron's type */
+	switch (n_type) {
+	case NEURON_TYPE_SIGMOID:
+		if (t != NULL) {
+			*output = uneural_activation_table_sigmoid(t, sum);
+		} else {
+			*output = uneural_activate_sigmoid(sum);
+		}
+		break;
+	case NEURON_TYPE_TANH:
+		if (t != NULL) {
+			*output = uneural_activation_table_tanh(t, sum);
+		} else {
+			*output = uneural_activate_tanh(sum);
+		}
+		break;
+	case NEURON_TYPE_RELU:
+		*output = uneural_activate_relu(sum);
+		break;
+	case NEURON_TYPE_LEAKY_RELU:
+		*output = uneural_activate_leaky_relu(sum);
+		break;
+	default:
+		return -1;
+	}
+
+	return 0;
+}
+
+int uneural_activate_layer(struct uneural_network *n,
+                           struct uneural_layer *work_layer)
 {
 
 	if (work_layer == NULL) {
 		return -NULL_ARG;
 	}
 
+	uint16_t num_inputs = work_layer->prev->num_neurons;
+	fix16_t inputs[UNEURAL_INPUT_CHUNK];
+
 	for (int i = 0; i < work_layer->num_neurons; i++) {
 
 		fix16_t temp = 0;
+		struct uneural_wide_sum wide =
+			uneural_wide_sum_init(uneural_layer_bias(work_layer, i));
 		struct uneural_neuron *work_neuron = &work_layer->neurons[i];
-
-		/* Clear the work neuron's output */
-		work_neuron->output = 0;
+		const fix16_t *weights = uneural_layer_weights(work_layer, i);
 
 		/* Assign the sum of products of the inputs * weights to the
-		 * neuron's output */
-		for (int j = 0; j < work_layer->prev->num_neurons; j++) {
-			temp = fix16_smul(work_neuron->weights[j],
-					  work_layer->prev->neurons[j].output);
+		 * neuron's output. The previous layer's outputs are spread
+		 * through its neuron structs, so gather them into a
+		 * contiguous chunk for the dot product kernel. When the whole
+		 * previous layer fits in one chunk it is only gathered once */
+		for (int c = 0; c < num_inputs; c += UNEURAL_INPUT_CHUNK) {
+			int len = num_inputs - c;
+
+			if (len > UNEURAL_INPUT_CHUNK) {
+				len = UNEURAL_INPUT_CHUNK;
+			}
+
+			if (i == 0 || num_inputs > UNEURAL_INPUT_CHUNK) {
+				for (int j = 0; j < len; j++) {
+					inputs[j] = work_layer->prev->neurons[c + j].output;
+				}
+			}
+
+			if (n->mac_mode == MAC_MODE_WIDE) {
+				wide = uneural_dot_wide(wide, &weights[c], inputs, len);
+			} else {
+				temp = fix16_vec_dot(temp, &weights[c], inputs, len);
+			}
+		}
 
-			work_neuron->output = fix16_sadd(work_neuron->output, temp);
+		/* Add the neuron's bias (already in the wide accumulator) */
+		if (n->mac_mode == MAC_MODE_WIDE) {
+			temp = uneural_wide_sum_to_fix16(wide);
+		} else {
+			temp = fix16_sadd(uneural_layer_bias(work_layer, i), temp);
 		}
 
-		/* Add the neuron's bias */
-		work_neuron->output = fix16_sadd(work_neuron->bias[0],
-						 work_neuron->output);
-
-		/* Fire the correct activation function for the neuron's type */
-		switch (*work_neuron->n_type) {
-		case NEURON_TYPE_SIGMOID:
-			work_neuron->output = uneural_activate_sigmoid(work_neuron->output);
-			break;
-		case NEURON_TYPE_TANH:
-			work_neuron->output = uneural_activate_tanh(work_neuron->output);
-			break;
-		case NEURON_TYPE_RELU:
-			work_neuron->output = uneural_activate_relu(work_neuron->output);
-			break;
-		case NEURON_TYPE_LEAKY_RELU:
-			work_neuron->output = uneural_activate_leaky_relu(work_neuron->output);
-			break;
-		default:
+		if (uneural_activate_neuron(n->act_table,
+					    uneural_layer_type(work_layer, i),
+					    temp, &temp)) {
 			return -1;
 		}
+
+		work_neuron->output = temp;
 	}
 
 	return 0;
@@ -134,7 +182,7 @@ int uneural_activate_network(struct uneural_network *n,
 	struct uneural_layer *work_layer = n->input->next;
 
 	while (work_layer != NULL) {
-		int result = uneural_activate_layer(work_layer);
+		int result = uneural_activate_layer(n, work_layer);
 
 		if (result) {
 			return result;
@@ -151,6 +199,264 @@ int uneural_activate_network(struct uneural_network *n,
 	return 0;
 }
 
+ssize_t uneural_network_get_batch_scratch_size(struct uneural_network *n)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	/* Two ping-ponged activation tiles, each wide enough for the
+	 * largest layer */
+	return (2 * uneural_network_largest_layer_size(n) *
+		UNEURAL_BATCH_TILE * sizeof(fix16_t));
+}
+
+/* Activates a layer for a tile of samples. Activations are stored
+ * feature-major (in[j * UNEURAL_BATCH_TILE + s]) so that each weight is
+ * loaded once and applied to every sample in the tile. Every sample
+ * still sees the same saturating sum order as uneural_activate_layer */
+static int uneural_activate_layer_tile(const struct uneural_network *n,
+                                       const struct uneural_layer *l,
+                                       const fix16_t *in,
+                                       fix16_t *out,
+                                       int tile)
+{
+	for (int i = 0; i < l->num_neurons; i++) {
+		const fix16_t *weights = uneural_layer_weights(l, i);
+		fix16_t bias = uneural_layer_bias(l, i);
+		uint32_t n_type = uneural_layer_type(l, i);
+		fix16_t acc[UNEURAL_BATCH_TILE] = { 0 };
+		struct uneural_wide_sum wide[UNEURAL_BATCH_TILE];
+
+		if (n->mac_mode == MAC_MODE_WIDE) {
+			for (int s = 0; s < tile; s++) {
+				wide[s] = uneural_wide_sum_init(bias);
+			}
+
+			for (int j = 0; j < l->prev->num_neurons; j++) {
+				fix16_t w = weights[j];
+				const fix16_t *x = &in[j * UNEURAL_BATCH_TILE];
+
+				for (int s = 0; s < tile; s++) {
+					uneural_wide_sum_mac(&wide[s], w, x[s]);
+				}
+			}
+
+			for (int s = 0; s < tile; s++) {
+				acc[s] = uneural_wide_sum_to_fix16(wide[s]);
+			}
+		} else {
+			for (int j = 0; j < l->prev->num_neurons; j++) {
+				fix16_vec_axpy(acc, weights[j],
+					       &in[j * UNEURAL_BATCH_TILE], tile);
+			}
+
+			for (int s = 0; s < tile; s++) {
+				acc[s] = fix16_sadd(bias, acc[s]);
+			}
+		}
+
+		for (int s = 0; s < tile; s++) {
+			if (uneural_activate_neuron(n->act_table, n_type, acc[s],
+						    &out[i * UNEURAL_BATCH_TILE + s])) {
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int uneural_activate_network_batch(struct uneural_network *n,
+                                   const fix16_t *inputs,
+                                   uint32_t count,
+                                   fix16_t *outputs,
+                                   fix16_t *scratch)
+{
+	if (n == NULL || inputs == NULL || outputs == NULL || scratch == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	uint16_t num_inputs = n->input->num_neurons;
+	uint16_t num_outputs = n->output->num_neurons;
+	uint32_t step = uneural_network_largest_layer_size(n) * UNEURAL_BATCH_TILE;
+
+	for (uint32_t base = 0; base < count; base += UNEURAL_BATCH_TILE) {
+		fix16_t *cur = scratch;
+		fix16_t *next = scratch + step;
+		int tile = count - base;
+
+		if (tile > UNEURAL_BATCH_TILE) {
+			tile = UNEURAL_BATCH_TILE;
+		}
+
+		/* Transpose the tile's input rows into feature-major order */
+		for (int s = 0; s < tile; s++) {
+			const fix16_t *row = &inputs[(base + s) * num_inputs];
+
+			for (int j = 0; j < num_inputs; j++) {
+				cur[j * UNEURAL_BATCH_TILE + s] = row[j];
+			}
+		}
+
+		for (struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+			int result = uneural_activate_layer_tile(n, l, cur, next, tile);
+
+			if (result) {
+				return result;
+			}
+
+			fix16_t *swap = cur;
+			cur = next;
+			next = swap;
+		}
+
+		for (int s = 0; s < tile; s++) {
+			fix16_t *row = &outputs[(base + s) * num_outputs];
+
+			for (int i = 0; i < num_outputs; i++) {
+				row[i] = cur[i * UNEURAL_BATCH_TILE + s];
+			}
+		}
+	}
+
+	return 0;
+}
+
+ssize_t uneural_ctx_get_data_requirement(struct uneural_network *n)
+{
+	ssize_t total_required = 0;
+
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	/* One activation per neuron, input layer included, laid out layer
+	 * after layer */
+	for (struct uneural_layer *l = n->input; l != NULL; l = l->next) {
+		total_required += l->num_neurons * sizeof(fix16_t);
+	}
+
+	return total_required;
+}
+
+int uneural_ctx_init(struct uneural_ctx *ctx,
+                     const struct uneural_network *n,
+                     fix16_t *data,
+                     ssize_t data_size)
+{
+	if (ctx == NULL || n == NULL || data == NULL) {
+		return -NULL_ARG;
+	}
+
+	ssize_t required = uneural_ctx_get_data_requirement((struct uneural_network*)n);
+
+	if (required < 0) {
+		return required;
+	}
+
+	if (data_size < required) {
+		return -DATA_STORAGE_INSUFFICIENT;
+	}
+
+	ctx->net = n;
+	ctx->activations = data;
+
+	return 0;
+}
+
+static int uneural_activate_layer_ctx(const struct uneural_network *n,
+                                      const struct uneural_layer *l,
+                                      const fix16_t *in,
+                                      fix16_t *out)
+{
+	for (int i = 0; i < l->num_neurons; i++) {
+		const fix16_t *weights = uneural_layer_weights(l, i);
+		fix16_t bias = uneural_layer_bias(l, i);
+		fix16_t temp;
+
+		if (n->mac_mode == MAC_MODE_WIDE) {
+			struct uneural_wide_sum wide = uneural_wide_sum_init(bias);
+
+			wide = uneural_dot_wide(wide, weights, in, l->prev->num_neurons);
+			temp = uneural_wide_sum_to_fix16(wide);
+		} else {
+			temp = fix16_vec_dot(0, weights, in, l->prev->num_neurons);
+			temp = fix16_sadd(bias, temp);
+		}
+
+		if (uneural_activate_neuron(n->act_table, uneural_layer_type(l, i),
+					    temp, &out[i])) {
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int uneural_activate_network_ctx(struct uneural_ctx *ctx,
+                                 const fix16_t *inputs,
+                                 fix16_t *outputs)
+{
+	if (ctx == NULL || ctx->net == NULL || inputs == NULL) {
+		return -NULL_ARG;
+	}
+
+	const struct uneural_network *n = ctx->net;
+
+	if (n->input == NULL) {
+		return -MISSING_INPUT_LAYER;
+	}
+
+	if (n->output == NULL) {
+		return -MISSING_OUTPUT_LAYER;
+	}
+
+	/* The network itself is only ever read here, all state lives in the
+	 * context, so any number of contexts may run concurrently against
+	 * the same network */
+	fix16_t *in = ctx->activations;
+
+	for (int i = 0; i < n->input->num_neurons; i++) {
+		in[i] = inputs[i];
+	}
+
+	for (const struct uneural_layer *l = n->input->next; l != NULL; l = l->next) {
+		fix16_t *out = in + l->prev->num_neurons;
+		int result = uneural_activate_layer_ctx(n, l, in, out);
+
+		if (result) {
+			return result;
+		}
+
+		in = out;
+	}
+
+	if (outputs != NULL) {
+		for (int i = 0; i < n->output->num_neurons; i++) {
+			outputs[i] = in[i];
+		}
+	}
+
+	return 0;
+}
+
 static struct uneural_layer *uneural_network_last_layer(struct uneural_network *n)
 {
 	struct uneural_layer *work_layer = n->input;
@@ -186,6 +492,18 @@ int uneural_network_add_input_layer(struct uneural_network *n,
 	return 0;
 }
 
+int uneural_network_set_mac_mode(struct uneural_network *n,
+                                 enum mac_mode mode)
+{
+	if (n == NULL) {
+		return -NULL_ARG;
+	}
+
+	n->mac_mode = mode;
+
+	return 0;
+}
+
 int uneural_network_set_layer_type(struct uneural_layer *l,
                                    enum neuron_type n_type)
 {
@@ -193,6 +511,10 @@ int uneural_network_set_layer_type(struct uneural_layer *l,
 		return -NULL_ARG;
 	}
 
+	if (l->storage_read_only) {
+		return -DATA_STORAGE_READ_ONLY;
+	}
+
 	for (int i = 0; i < l->num_neurons; i++) {
 		*l->neurons[i].n_type = (uint32_t)n_type;
 	}
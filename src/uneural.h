@@ -3,10 +3,17 @@
 
 #include <fix16.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <sys/types.h>
 
 #define STORAGE_INIT_MAGIC 0xC0A1E5CE
 
+/* Alignment (in bytes) of each per-layer block in the layer-major
+ * storage layout */
+#ifndef UNEURAL_CACHE_LINE
+#define UNEURAL_CACHE_LINE 64
+#endif
+
 enum {
 	NULL_ARG = 1,
 	MISSING_INPUT_LAYER,
@@ -18,6 +25,19 @@ enum {
 	DATA_STORAGE_UNALIGNED,
 	MISSING_NEURON,
 	MISSING_DATA_STORAGE,
+	DATA_STORAGE_ATTACHED,
+	ACTIVATION_TABLE_SIZE,
+	MIXED_LAYER_TYPES,
+	DATASET_IO,
+	DATASET_FORMAT,
+	CSV_FORMAT,
+	MODEL_IO,
+	MODEL_FORMAT,
+	MODEL_CHECKSUM,
+	RELOAD_SHAPE_MISMATCH,
+	DATA_STORAGE_READ_ONLY,
+	DATASET_SHAPE_MISMATCH,
+	RELOAD_BAD_READER,
 };
 
 enum neuron_type {
@@ -27,6 +47,14 @@ enum neuron_type {
 	NEURON_TYPE_LEAKY_RELU,
 };
 
+enum storage_layout {
+	/* Each neuron's type, bias and weights stored back-to-back */
+	STORAGE_LAYOUT_NEURON = 0,
+	/* Each layer owns one activation descriptor, one bias vector
+	 * and one row-major weight matrix, all cache line aligned */
+	STORAGE_LAYOUT_LAYER,
+};
+
 struct uneural_neuron {
 	uint32_t *n_type;
 	fix16_t *bias;
@@ -39,13 +67,195 @@ struct uneural_layer {
 	struct uneural_layer *prev;
 	struct uneural_layer *next;
 	struct uneural_neuron *neurons;
+	/* Only populated when attached with STORAGE_LAYOUT_LAYER. The
+	 * per-neuron pointers above are then views into these */
+	uint32_t *n_type;
+	fix16_t *bias;
+	fix16_t *weights;
+	/* Set by uneural_network_data_attach_const, the layer's types can
+	 * then not be changed */
+	bool storage_read_only;
+};
+
+enum mac_mode {
+	/* Saturate after every multiply and every add, as fix16_smul and
+	 * fix16_sadd would */
+	MAC_MODE_SATURATE = 0,
+	/* Sum the raw 64 bit products (and the bias) and round and
+	 * saturate once per neuron. Sums are kept exactly, even where
+	 * they would overflow an int64, so they no longer depend on
+	 * summation order */
+	MAC_MODE_WIDE,
+};
+
+/* Half-width of the input range covered by an activation table */
+#define UNEURAL_ACTIVATION_TABLE_RANGE 16
+
+/* Sampled sigmoid used in place of fix16_exp based sigmoid and tanh.
+ * Lookups interpolate linearly between size + 1 samples spread evenly
+ * over [-UNEURAL_ACTIVATION_TABLE_RANGE, UNEURAL_ACTIVATION_TABLE_RANGE].
+ * Worst case error against the exact functions over every fix16
+ * input (as reported by uneural_activation_table_max_error) is 26
+ * units (~4e-4) for 256 intervals, 8 for 512, 4 for 1024 to 16384 and
+ * 2 for 32768 */
+struct uneural_activation_table {
+	fix16_t *sigmoid;
+	uint16_t size;
+	uint8_t shift;
 };
 
 struct uneural_network {
 	uint16_t num_layers;
 	bool storage_attached;
+	/* Set by uneural_network_data_attach_const, training then refuses
+	 * to run */
+	bool storage_read_only;
+	enum storage_layout layout;
+	const struct uneural_activation_table *act_table;
+	enum mac_mode mac_mode;
 	struct uneural_layer *input;
 	struct uneural_layer *output;
+	/* Storage blob given to uneural_network_data_attach and the number
+	 * of bytes of it in use */
+	fix16_t *storage;
+	ssize_t storage_size;
+};
+
+/* Per-inference state. Holds the activations of every layer so that a
+ * network's weights can be shared read-only between any number of
+ * concurrent inferences */
+struct uneural_ctx {
+	const struct uneural_network *net;
+	fix16_t *activations;
+};
+
+/* Handle to an int8 quantized copy of a network, see
+ * uneural_qnetwork_quantize. Weights are stored as int8 with one fix16
+ * scale per layer; biases and activations stay Q16.16 */
+struct uneural_qnetwork {
+	const uint32_t *data;
+	uint16_t num_layers;
+	uint16_t num_inputs;
+	uint16_t num_outputs;
+	uint16_t max_width;
+	/* Cleared by attach, may be set afterwards */
+	const struct uneural_activation_table *act_table;
+};
+
+enum optimizer_type {
+	/* w += rate * g */
+	OPTIMIZER_SGD = 0,
+	/* Heavy ball momentum, v = momentum * v + g, w += rate * v */
+	OPTIMIZER_MOMENTUM,
+	/* Nesterov momentum, w += rate * (g + momentum * v) */
+	OPTIMIZER_NESTEROV,
+	/* Adam, with momentum as beta1 */
+	OPTIMIZER_ADAM,
+	/* iRprop-, sign based steps per weight, starting at the rate.
+	 * Meant for full batch training */
+	OPTIMIZER_RPROP,
+};
+
+/* Weight update rule applied to accumulated gradients. Per-weight state
+ * lives in a caller buffer sized by uneural_optimizer_get_state_size.
+ * init fills in defaults (momentum/beta1 0.9, beta2 0.99, epsilon
+ * 0.001, RPROP step factors 1.2/0.5 bounded to [1 unit, 50]), which
+ * may be changed before the first apply */
+struct uneural_optimizer {
+	enum optimizer_type type;
+	fix16_t rate;
+	fix16_t momentum;
+	fix16_t beta2;
+	fix16_t epsilon;
+	/* Adam bias correction, beta1^t and beta2^t */
+	fix16_t beta1_pow;
+	fix16_t beta2_pow;
+	fix16_t eta_plus;
+	fix16_t eta_minus;
+	fix16_t step_min;
+	fix16_t step_max;
+	ssize_t num_params;
+	fix16_t *state;
+};
+
+/* Training samples, either as arrays of rows (strides in fix16_t
+ * elements, 0 meaning densely packed) or, when inputs is NULL, through
+ * get, which points input and target at sample index. input_width and
+ * target_width give the number of values per sample; training and
+ * evaluation refuse a dataset whose widths differ from the network's.
+ * 0 means the network's widths are assumed */
+struct uneural_dataset {
+	uint32_t count;
+	uint16_t input_width;
+	uint16_t target_width;
+	const fix16_t *inputs;
+	const fix16_t *targets;
+	size_t input_stride;
+	size_t target_stride;
+	int (*get)(void *arg,
+		   uint32_t index,
+		   const fix16_t **input,
+		   const fix16_t **target);
+	void *arg;
+};
+
+/* Size of the (padded) header at the start of a dataset file, keeping
+ * the rows that follow cache line aligned */
+#define UNEURAL_DATASET_HEADER_SIZE 64
+
+/* A dataset file mapped into memory by uneural_dataset_map */
+struct uneural_dataset_map {
+	void *addr;
+	size_t length;
+	uint16_t input_width;
+	uint16_t target_width;
+};
+
+/* One layer of a model file: its width and, past the input layer, the
+ * activation shared by all of its neurons, or UNEURAL_MODEL_MIXED_TYPES
+ * if they differ. uneural_model_build checks it against the blob */
+struct uneural_model_layer {
+	uint16_t num_neurons;
+	uint16_t n_type;
+};
+
+#define UNEURAL_MODEL_MIXED_TYPES 0xFFFF
+
+/* A model file mapped into memory by uneural_model_map. data points at
+ * the storage blob inside the mapping */
+struct uneural_model {
+	void *addr;
+	size_t length;
+	uint16_t num_layers;
+	const struct uneural_model_layer *layers;
+	enum storage_layout layout;
+	enum mac_mode mac_mode;
+	fix16_t *data;
+	ssize_t data_size;
+};
+
+/* Hot swappable network for long running inference, see
+ * uneural_reload_publish. slots holds one cache line per reader */
+struct uneural_reload {
+	struct uneural_network *current;
+	uint64_t epoch;
+	void *slots;
+	uint16_t num_readers;
+};
+
+struct uneural_train_params {
+	uint32_t epochs;
+	/* Samples per weight update, 0 or 1 for per-sample updates */
+	uint32_t batch_size;
+	/* Reshuffles the sample order every epoch unless 0 */
+	uint32_t shuffle_seed;
+	/* Stop once an epoch's loss is at or below this */
+	fix16_t target_loss;
+	/* Stop after this many epochs without a new best loss, 0 never */
+	uint32_t patience;
+	/* Updates through opt if set, plain SGD at rate otherwise */
+	struct uneural_optimizer *opt;
+	fix16_t rate;
 };
 
 #define DECLARE_UNEURAL_LAYER(name, max_size)                           \
@@ -57,6 +267,20 @@ struct uneural_network {
 int uneural_activate_network(struct uneural_network *n,
                              const fix16_t *inputs,
                              fix16_t *outputs);
+ssize_t uneural_network_get_batch_scratch_size(struct uneural_network *n);
+int uneural_activate_network_batch(struct uneural_network *n,
+                                   const fix16_t *inputs,
+                                   uint32_t count,
+                                   fix16_t *outputs,
+                                   fix16_t *scratch);
+ssize_t uneural_ctx_get_data_requirement(struct uneural_network *n);
+int uneural_ctx_init(struct uneural_ctx *ctx,
+                     const struct uneural_network *n,
+                     fix16_t *data,
+                     ssize_t data_size);
+int uneural_activate_network_ctx(struct uneural_ctx *ctx,
+                                 const fix16_t *inputs,
+                                 fix16_t *outputs);
 int uneural_network_add_hidden_layer(struct uneural_network *n,
                                      struct uneural_layer *l);
 int uneural_network_add_output_layer(struct uneural_network *n,
@@ -65,13 +289,70 @@ int uneural_network_add_input_layer(struct uneural_network *n,
                                     struct uneural_layer *l);
 int uneural_network_set_layer_type(struct uneural_layer *l,
                                    enum neuron_type n_type);
+int uneural_network_set_mac_mode(struct uneural_network *n,
+                                 enum mac_mode mode);
 
+int uneural_network_set_storage_layout(struct uneural_network *n,
+                                       enum storage_layout layout);
 int uneural_network_data_attach(struct uneural_network *n,
                                 fix16_t *data,
                                 ssize_t data_size);
+/* Attaches storage that is never written, e.g. a const array from
+ * uneural_network_emit_storage placed in flash. Inference works as
+ * usual; anything that would modify the weights or the activation
+ * types fails with -DATA_STORAGE_READ_ONLY */
+int uneural_network_data_attach_const(struct uneural_network *n,
+                                      const fix16_t *data,
+                                      ssize_t data_size);
 ssize_t uneural_network_get_data_requirement(struct uneural_network *n);
 int uneural_network_init_storage(fix16_t *net_data, ssize_t storage_size);
 
+/* Activation functions */
+fix16_t uneural_activate_sigmoid(fix16_t sum);
+fix16_t uneural_activate_tanh(fix16_t sum);
+fix16_t uneural_activate_relu(fix16_t sum);
+fix16_t uneural_activate_leaky_relu(fix16_t sum);
+
+ssize_t uneural_activation_table_get_data_requirement(uint16_t size);
+int uneural_activation_table_init(struct uneural_activation_table *t,
+                                  fix16_t *data,
+                                  ssize_t data_size,
+                                  uint16_t size);
+fix16_t uneural_activation_table_sigmoid(const struct uneural_activation_table *t,
+                                         fix16_t x);
+fix16_t uneural_activation_table_tanh(const struct uneural_activation_table *t,
+                                      fix16_t x);
+fix16_t uneural_activation_table_max_error(const struct uneural_activation_table *t);
+int uneural_network_set_activation_table(struct uneural_network *n,
+                                         const struct uneural_activation_table *t);
+
+/* Code generation. Writes a standalone C file defining
+ * void name(const fix16_t *input, fix16_t *output) with the network's
+ * current weights baked in, bit-exact with uneural_activate_network */
+int uneural_network_emit_c(struct uneural_network *n,
+                           FILE *out,
+                           const char *name);
+/* Writes a C header defining the network's storage blob as a const,
+ * cache line aligned array called name, for
+ * uneural_network_data_attach_const(n, name, sizeof(name)) */
+int uneural_network_emit_storage(struct uneural_network *n,
+                                 FILE *out,
+                                 const char *name);
+
+/* Quantized inference API */
+ssize_t uneural_qnetwork_get_data_requirement(struct uneural_network *n);
+int uneural_qnetwork_quantize(struct uneural_network *n,
+                              uint32_t *data,
+                              ssize_t data_size);
+int uneural_qnetwork_attach(struct uneural_qnetwork *q,
+                            const uint32_t *data,
+                            ssize_t data_size);
+ssize_t uneural_qnetwork_get_scratch_size(const struct uneural_qnetwork *q);
+int uneural_qnetwork_activate(const struct uneural_qnetwork *q,
+                              const fix16_t *inputs,
+                              fix16_t *outputs,
+                              fix16_t *scratch);
+
 /* Training API */
 int uneural_network_randomize_weights(struct uneural_network *n);
 ssize_t uneural_network_get_training_scratch_size(struct uneural_network *n);
@@ -81,5 +362,149 @@ int uneural_network_backprop(struct uneural_network *n,
                              fix16_t training_rate,
                              fix16_t *scratch,
                              fix16_t *output_error);
+/* Same as uneural_network_backprop, but skips the forward pass and
+ * trusts the neuron outputs left by the last uneural_activate_network
+ * call. Only valid if the weights have not changed since */
+int uneural_network_backprop_cached(struct uneural_network *n,
+                                    const fix16_t *expected_output,
+                                    fix16_t training_rate,
+                                    fix16_t *scratch,
+                                    fix16_t *output_error);
+/* Runs inference, returning the (pre-update) outputs, then trains on
+ * the same pass. outputs may be NULL */
+int uneural_network_infer_and_learn(struct uneural_network *n,
+                                    const fix16_t *input,
+                                    const fix16_t *expected_output,
+                                    fix16_t training_rate,
+                                    fix16_t *scratch,
+                                    fix16_t *outputs,
+                                    fix16_t *output_error);
+/* Gradients hold, per layer and per neuron, the bias followed by one
+ * entry per input weight, in the descent direction. compute_gradients
+ * adds one sample's gradients (scratch as for backprop); apply_gradients
+ * adds training_rate times their mean over batch_size samples to the
+ * weights and clears the buffer */
+ssize_t uneural_network_get_gradient_size(struct uneural_network *n);
+int uneural_network_compute_gradients(struct uneural_network *n,
+                                      const fix16_t *input,
+                                      const fix16_t *expected_output,
+                                      fix16_t *grads,
+                                      fix16_t *scratch,
+                                      fix16_t *output_error);
+int uneural_network_apply_gradients(struct uneural_network *n,
+                                    fix16_t *grads,
+                                    fix16_t training_rate,
+                                    uint32_t batch_size);
+ssize_t uneural_optimizer_get_state_size(struct uneural_network *n,
+                                         enum optimizer_type type);
+int uneural_optimizer_init(struct uneural_optimizer *opt,
+                           struct uneural_network *n,
+                           enum optimizer_type type,
+                           fix16_t training_rate,
+                           fix16_t *state,
+                           ssize_t state_size);
+int uneural_optimizer_apply(struct uneural_optimizer *opt,
+                            struct uneural_network *n,
+                            fix16_t *grads,
+                            uint32_t batch_size);
+/* Accumulates gradients over count samples into grads (zeroed, sized
+ * by uneural_network_get_gradient_size) and applies them through opt */
+int uneural_network_train_batch(struct uneural_network *n,
+                                struct uneural_optimizer *opt,
+                                const fix16_t *inputs,
+                                const fix16_t *expected_outputs,
+                                uint32_t count,
+                                fix16_t *grads,
+                                fix16_t *scratch);
+ssize_t uneural_train_get_scratch_size(struct uneural_network *n,
+                                       const struct uneural_dataset *data);
+/* Trains for up to params->epochs epochs, storing each epoch's mean
+ * squared error in epoch_loss (may be NULL) and the number of epochs
+ * actually run in epochs_run (may be NULL) */
+int uneural_train_epochs(struct uneural_network *n,
+                         const struct uneural_dataset *data,
+                         const struct uneural_train_params *params,
+                         void *scratch,
+                         fix16_t *epoch_loss,
+                         uint32_t *epochs_run);
+/* Mean squared error of the network's outputs over a dataset */
+int uneural_network_evaluate(struct uneural_network *n,
+                             const struct uneural_dataset *data,
+                             fix16_t *mse);
+
+/* Binary dataset files, not available with UNEURAL_NO_MMAP. map points
+ * data at the rows in place; it stays valid until unmap */
+int uneural_dataset_save(const char *path,
+                         const struct uneural_dataset *data,
+                         uint16_t input_width,
+                         uint16_t target_width);
+int uneural_dataset_map(const char *path,
+                        struct uneural_dataset *data,
+                        struct uneural_dataset_map *map);
+int uneural_dataset_unmap(struct uneural_dataset_map *map);
+/* Number of non-blank lines in text */
+ssize_t uneural_csv_count_rows(const char *text, size_t length);
+/* Parses length bytes of delimited text, columns values per line, into
+ * out row by row. Blank lines are skipped and lines may end in "\r\n".
+ * Returns the number of rows, -DATA_STORAGE_INSUFFICIENT if there are
+ * more than max_rows or -CSV_FORMAT if a line is malformed */
+ssize_t uneural_csv_parse(const char *text,
+                          size_t length,
+                          char delimiter,
+                          uint16_t columns,
+                          fix16_t *out,
+                          size_t max_rows,
+                          uint16_t num_threads);
+/* Model files, not available with UNEURAL_NO_MMAP. A model file holds
+ * the topology and the storage blob of an attached network. map checks
+ * the header (and the checksum of the blob if verify is set), build
+ * links up a network around the blob in place, using a caller buffer of
+ * uneural_model_get_network_size bytes for the layers and neurons */
+int uneural_model_save(struct uneural_network *n, const char *path);
+int uneural_model_map(const char *path,
+                      struct uneural_model *model,
+                      bool verify);
+ssize_t uneural_model_get_network_size(const struct uneural_model *model);
+int uneural_model_build(const struct uneural_model *model,
+                        struct uneural_network *n,
+                        void *buf,
+                        ssize_t buf_size);
+int uneural_model_unmap(struct uneural_model *model);
+/* Hot reload. Each reader thread uses its own reader index and runs
+ * inference through uneural_reload_activate (or between enter and exit
+ * with a ctx), never blocking. publish swaps in a new network with the
+ * same input and output widths, waits until no reader can still be
+ * using the previous one and hands it back through old, after which its
+ * storage may be freed or unmapped. Publishers must not race each
+ * other. activations must fit the largest network ever published.
+ * A reader index past the num_readers given to init is refused with
+ * -RELOAD_BAD_READER, or a NULL network from enter */
+ssize_t uneural_reload_get_slots_size(uint16_t num_readers);
+int uneural_reload_init(struct uneural_reload *r,
+                        struct uneural_network *n,
+                        void *slots,
+                        ssize_t slots_size,
+                        uint16_t num_readers);
+const struct uneural_network *uneural_reload_enter(struct uneural_reload *r,
+                                                   uint16_t reader);
+int uneural_reload_exit(struct uneural_reload *r, uint16_t reader);
+int uneural_reload_activate(struct uneural_reload *r,
+                            uint16_t reader,
+                            fix16_t *activations,
+                            ssize_t activations_size,
+                            const fix16_t *inputs,
+                            fix16_t *outputs);
+int uneural_reload_publish(struct uneural_reload *r,
+                           struct uneural_network *n,
+                           struct uneural_network **old);
+ssize_t uneural_network_get_parallel_scratch_size(struct uneural_network *n,
+                                                  uint16_t num_threads);
+int uneural_network_train_parallel(struct uneural_network *n,
+                                   const fix16_t *inputs,
+                                   const fix16_t *expected_outputs,
+                                   uint32_t count,
+                                   fix16_t training_rate,
+                                   uint16_t num_threads,
+                                   fix16_t *scratch);
 
 #endif  /* _UNEURAL_H_ */
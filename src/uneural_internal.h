@@ -0,0 +1,169 @@
+#ifndef _UNEURAL_INTERNAL_H_
+#define _UNEURAL_INTERNAL_H_
+
+#include <fix16.h>
+#include <uneural.h>
+
+/* Number of previous-layer outputs gathered onto the stack at a time
+ * when activating a layer through the per-neuron API */
+#ifndef UNEURAL_INPUT_CHUNK
+#define UNEURAL_INPUT_CHUNK 64
+#endif
+
+/* Number of samples pushed through each layer together by
+ * uneural_activate_network_batch */
+#ifndef UNEURAL_BATCH_TILE
+#define UNEURAL_BATCH_TILE 8
+#endif
+
+/* Most workers uneural_network_train_parallel and uneural_csv_parse
+ * split their work across. Their descriptors live on the stack, so
+ * larger thread counts are lowered to this */
+#ifndef UNEURAL_MAX_THREADS
+#define UNEURAL_MAX_THREADS 64
+#endif
+
+uint16_t uneural_network_largest_layer_size(struct uneural_network *n);
+
+/* Layer-major storage lets us stream straight through the layer's
+ * weight matrix rather than chasing each neuron's pointers */
+static inline const fix16_t *uneural_layer_weights(const struct uneural_layer *l,
+                                                   int i)
+{
+	if (l->weights != NULL) {
+		return &l->weights[i * l->prev->num_neurons];
+	}
+	return l->neurons[i].weights;
+}
+
+static inline fix16_t uneural_layer_bias(const struct uneural_layer *l, int i)
+{
+	if (l->bias != NULL) {
+		return l->bias[i];
+	}
+	return l->neurons[i].bias[0];
+}
+
+static inline uint32_t uneural_layer_type(const struct uneural_layer *l, int i)
+{
+	if (l->n_type != NULL) {
+		return *l->n_type;
+	}
+	return *l->neurons[i].n_type;
+}
+
+/* Applies the activation function for n_type to sum, through the table
+ * t for sigmoid and tanh when t is not NULL */
+int uneural_activate_neuron(const struct uneural_activation_table *t,
+                            uint32_t n_type,
+                            fix16_t sum,
+                            fix16_t *output);
+
+/* Number of fix16_t entries in a gradient buffer: for every neuron past
+ * the input layer, one for the bias and one per input weight */
+ssize_t uneural_network_gradient_count(const struct uneural_network *n);
+
+/* Back propagates one sample and adds its gradients (in the descent
+ * direction, i.e. the amounts to add to each weight) into grads.
+ * Outputs are read from ctx style activations when acts is non-NULL,
+ * from the neurons otherwise. deltas needs room for three times the
+ * largest layer. Weights are not modified */
+int uneural_network_accumulate_gradients(const struct uneural_network *n,
+                                         const fix16_t *acts,
+                                         const fix16_t *expected_output,
+                                         fix16_t *grads,
+                                         fix16_t *deltas,
+                                         fix16_t *output_error);
+
+/* Mean of a gradient summed over batch_size samples, rounded to
+ * nearest. The identity for a batch of one */
+static inline fix16_t uneural_gradient_mean(fix16_t grad, uint32_t batch_size)
+{
+	int64_t half = batch_size / 2;
+
+	if (batch_size <= 1) {
+		return grad;
+	}
+
+	if (grad >= 0) {
+		return ((int64_t)grad + half) / batch_size;
+	}
+	return ((int64_t)grad - half) / (int64_t)batch_size;
+}
+
+/* An exact Q32.32 sum of a neuron's raw products, hi * 2^32 + lo. A
+ * product can be as large as 2^62, so two of them already overflow an
+ * int64. Each product p instead adds p >> 32 (at most 2^30) to hi and
+ * p & 0xFFFFFFFF (below 2^32) to lo, and neither half can overflow for
+ * the up to 65535 inputs a neuron has. Used by MAC_MODE_WIDE */
+struct uneural_wide_sum {
+	int64_t hi;
+	int64_t lo;
+};
+
+static inline struct uneural_wide_sum uneural_wide_sum_init(fix16_t bias)
+{
+	struct uneural_wide_sum acc = { 0, (int64_t)bias * 65536 };
+
+	return acc;
+}
+
+static inline void uneural_wide_sum_mac(struct uneural_wide_sum *acc,
+                                        fix16_t w,
+                                        fix16_t x)
+{
+	int64_t product = (int64_t)w * x;
+
+	acc->hi += product >> 32;
+	acc->lo += product & 0xFFFFFFFF;
+}
+
+/* Returns acc plus the raw Q32.32 products weights[i] * inputs[i],
+ * with no rounding or saturation */
+struct uneural_wide_sum uneural_dot_wide(struct uneural_wide_sum acc,
+                                         const fix16_t *weights,
+                                         const fix16_t *inputs,
+                                         uint16_t count);
+
+/* Returns acc plus the raw products weights[i] * inputs[i] of int8
+ * weights and fix16 inputs, with no rounding or saturation. Used by the
+ * quantized inference path. Each product is below 2^38, so unlike the
+ * wide sum a plain int64 holds any neuron's total */
+int64_t uneural_dot_q8(int64_t acc,
+                       const int8_t *weights,
+                       const fix16_t *inputs,
+                       uint16_t count);
+
+/* Rounds a Q32.32 accumulator the same way fix16_mul rounds its
+ * product, then saturates it to a fix16_t */
+static inline fix16_t uneural_wide_to_fix16(int64_t acc)
+{
+	int64_t result = (acc + 0x7FFF + (acc >= 0)) >> 16;
+
+	if (result > fix16_maximum) {
+		return fix16_maximum;
+	}
+	if (result < fix16_minimum) {
+		return fix16_minimum;
+	}
+	return (fix16_t)result;
+}
+
+/* Rounds and saturates an exact wide sum. Once hi reaches 2^15 the sum
+ * is at least 2^47 and saturates whatever lo holds, below that it fits
+ * an int64 again */
+static inline fix16_t uneural_wide_sum_to_fix16(struct uneural_wide_sum acc)
+{
+	int64_t hi = acc.hi + (acc.lo >> 32);
+	int64_t lo = acc.lo & 0xFFFFFFFF;
+
+	if (hi >= 32768) {
+		return fix16_maximum;
+	}
+	if (hi < -32768) {
+		return fix16_minimum;
+	}
+	return uneural_wide_to_fix16(hi * 4294967296 + lo);
+}
+
+#endif  /* _UNEURAL_INTERNAL_H_ */
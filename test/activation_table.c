@@ -0,0 +1,76 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#define MAX_SIZE 32768
+
+static fix16_t table_data[MAX_SIZE + 1];
+
+/* Worst case error over every fix16 input for each table size from 16
+ * to 32768 intervals, as documented in uneural.h */
+static const fix16_t expected_error[] = {
+	5358, 1528, 392, 100, 26, 8, 4, 4, 4, 4, 4, 2
+};
+
+static fix16_t abs_diff(fix16_t a, fix16_t b)
+{
+	return (a > b) ? (a - b) : (b - a);
+}
+
+static void test_activation_table_error(void **state)
+{
+	int i = 0;
+
+	for (int size = 16; size <= MAX_SIZE; size *= 2, i++) {
+		struct uneural_activation_table t;
+		fix16_t max_error = 0;
+
+		assert_int_equal(uneural_activation_table_init(&t, table_data,
+							       sizeof(table_data),
+							       size), 0);
+
+		/* Every input in the table range, and some way past both
+		 * ends where the end samples are returned */
+		for (fix16_t x = F16(-20); x <= F16(20); x++) {
+			max_error = fix16_max(max_error,
+				abs_diff(uneural_activation_table_sigmoid(&t, x),
+					 uneural_activate_sigmoid(x)));
+			max_error = fix16_max(max_error,
+				abs_diff(uneural_activation_table_tanh(&t, x),
+					 uneural_activate_tanh(x)));
+		}
+
+		assert_int_equal(max_error, expected_error[i]);
+		assert_int_equal(uneural_activation_table_max_error(&t), max_error);
+	}
+}
+
+static void test_activation_table_size(void **state)
+{
+	struct uneural_activation_table t;
+
+	assert_int_equal(uneural_activation_table_get_data_requirement(1000),
+			 -ACTIVATION_TABLE_SIZE);
+	assert_int_equal(uneural_activation_table_get_data_requirement(8),
+			 -ACTIVATION_TABLE_SIZE);
+	assert_int_equal(uneural_activation_table_get_data_requirement(1024),
+			 1025 * sizeof(fix16_t));
+	assert_int_equal(uneural_activation_table_init(&t, table_data,
+						       1024 * sizeof(fix16_t),
+						       1024),
+			 -DATA_STORAGE_INSUFFICIENT);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_activation_table_error),
+		cmocka_unit_test(test_activation_table_size),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
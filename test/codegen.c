@@ -0,0 +1,213 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+/* Builds networks, writes them out with uneural_network_emit_c,
+ * compiles the result against the library and checks that it gives
+ * exactly the outputs of uneural_activate_network */
+
+#define NUM_INPUTS 6
+#define NUM_OUTPUTS 4
+#define NUM_SAMPLES 2000
+
+DECLARE_UNEURAL_LAYER(input_layer, NUM_INPUTS);
+DECLARE_UNEURAL_LAYER(hidden1_layer, 9);
+DECLARE_UNEURAL_LAYER(hidden2_layer, 5);
+DECLARE_UNEURAL_LAYER(output_layer, NUM_OUTPUTS);
+
+static struct uneural_network network;
+static fix16_t *storage;
+static fix16_t table_data[1025];
+static struct uneural_activation_table table;
+static fix16_t inputs[NUM_SAMPLES][NUM_INPUTS];
+static fix16_t outputs[NUM_SAMPLES][NUM_OUTPUTS];
+
+/* Mostly moderate values, with zeros and values large enough to
+ * saturate the weighted sums mixed in */
+static fix16_t random_value(fix16_t range)
+{
+	uint32_t r = test_random();
+
+	switch (r >> 28) {
+	case 0:
+		return 0;
+	case 1:
+		return fix16_maximum;
+	case 2:
+		return fix16_minimum;
+	default:
+		return (fix16_t)((int64_t)(int32_t)r * range >> 31);
+	}
+}
+
+static void create_network(enum storage_layout layout, enum mac_mode mode)
+{
+	struct uneural_layer *layers[] = {
+		&input_layer, &hidden1_layer, &hidden2_layer, &output_layer
+	};
+
+	/* The layers are shared between the networks built here */
+	test_connect_network(&network, layers, 4);
+	assert_int_equal(uneural_network_set_storage_layout(&network, layout), 0);
+	assert_int_equal(uneural_network_set_mac_mode(&network, mode), 0);
+
+	free(storage);
+	storage = test_attach_storage(&network);
+
+	assert_int_equal(uneural_network_set_layer_type(&hidden1_layer, NEURON_TYPE_TANH), 0);
+	assert_int_equal(uneural_network_set_layer_type(&hidden2_layer, NEURON_TYPE_LEAKY_RELU), 0);
+	assert_int_equal(uneural_network_set_layer_type(&output_layer, NEURON_TYPE_SIGMOID), 0);
+
+	/* Neurons of a layer only have types of their own in the neuron
+	 * layout */
+	if (layout == STORAGE_LAYOUT_NEURON) {
+		*hidden2_layer.neurons[1].n_type = NEURON_TYPE_RELU;
+		*output_layer.neurons[2].n_type = NEURON_TYPE_TANH;
+	}
+
+	for (int l = 1; l < 4; l++) {
+		for (int i = 0; i < layers[l]->num_neurons; i++) {
+			struct uneural_neuron *neuron = &layers[l]->neurons[i];
+
+			*neuron->bias = random_value(F16(2));
+			for (int j = 0; j < layers[l - 1]->num_neurons; j++) {
+				neuron->weights[j] = random_value(F16(4));
+			}
+		}
+	}
+}
+
+/* Emits the network along with a main that runs it over every sample,
+ * compiles both and runs the program */
+static void run_generated(const char *dir)
+{
+	char path[256];
+	char command[1024];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/net.c", dir);
+	f = fopen(path, "w");
+	assert_non_null(f);
+	assert_int_equal(uneural_network_emit_c(&network, f, "test_net"), 0);
+	fprintf(f,
+		"\n#include <stdio.h>\n\n"
+		"int main(void)\n"
+		"{\n"
+		"\tfix16_t in[%d], out[%d];\n\n"
+		"\twhile (fread(in, sizeof(in), 1, stdin) == 1) {\n"
+		"\t\ttest_net(in, out);\n"
+		"\t\tfwrite(out, sizeof(out), 1, stdout);\n"
+		"\t}\n\n"
+		"\treturn 0;\n"
+		"}\n", NUM_INPUTS, NUM_OUTPUTS);
+	assert_int_equal(fclose(f), 0);
+
+	snprintf(path, sizeof(path), "%s/inputs", dir);
+	f = fopen(path, "wb");
+	assert_non_null(f);
+	assert_int_equal(fwrite(inputs, sizeof(inputs), 1, f), 1);
+	assert_int_equal(fclose(f), 0);
+
+	/* Run from the top of the tree by make test. --coverage as the
+	 * library is instrumented there */
+	snprintf(command, sizeof(command),
+		 "${CC:-cc} -O2 -Isrc -Ilibfixmath/libfixmath --coverage "
+		 "-o %s/net %s/net.c -L. -luneural -pthread && "
+		 "%s/net < %s/inputs > %s/outputs", dir, dir, dir, dir, dir);
+	assert_int_equal(system(command), 0);
+
+	snprintf(path, sizeof(path), "%s/outputs", dir);
+	f = fopen(path, "rb");
+	assert_non_null(f);
+	assert_int_equal(fread(outputs, sizeof(outputs), 1, f), 1);
+	assert_int_equal(fclose(f), 0);
+}
+
+static void check_generated(enum storage_layout layout,
+                            enum mac_mode mode,
+                            bool use_table)
+{
+	char dir[] = "/tmp/uneural_codegenXXXXXX";
+	char command[64];
+
+	create_network(layout, mode);
+
+	if (use_table) {
+		assert_int_equal(uneural_activation_table_init(&table, table_data,
+							       sizeof(table_data),
+							       1024), 0);
+		assert_int_equal(uneural_network_set_activation_table(&network, &table), 0);
+	}
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			inputs[s][i] = random_value(F16(8));
+		}
+	}
+
+	/* On the first sample one neuron's products sum far past the
+	 * int64 range, and it has to saturate rather than wrap */
+	*hidden1_layer.neurons[0].bias = 0;
+	for (int i = 0; i < NUM_INPUTS; i++) {
+		hidden1_layer.neurons[0].weights[i] = fix16_maximum;
+		inputs[0][i] = fix16_maximum;
+	}
+
+	assert_non_null(mkdtemp(dir));
+	run_generated(dir);
+	snprintf(command, sizeof(command), "rm -rf %s", dir);
+	assert_int_equal(system(command), 0);
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		fix16_t expected[NUM_OUTPUTS];
+
+		assert_int_equal(uneural_activate_network(&network, inputs[s], expected), 0);
+		assert_memory_equal(outputs[s], expected, sizeof(expected));
+	}
+
+	assert_int_equal(uneural_activate_network(&network, inputs[0], outputs[0]), 0);
+	assert_int_equal(hidden1_layer.neurons[0].output, use_table ?
+			 uneural_activation_table_tanh(&table, fix16_maximum) :
+			 uneural_activate_tanh(fix16_maximum));
+}
+
+static void test_codegen_neuron_layout(void **state)
+{
+	check_generated(STORAGE_LAYOUT_NEURON, MAC_MODE_SATURATE, false);
+}
+
+static void test_codegen_layer_layout(void **state)
+{
+	check_generated(STORAGE_LAYOUT_LAYER, MAC_MODE_SATURATE, false);
+}
+
+static void test_codegen_wide(void **state)
+{
+	check_generated(STORAGE_LAYOUT_NEURON, MAC_MODE_WIDE, false);
+}
+
+static void test_codegen_table(void **state)
+{
+	check_generated(STORAGE_LAYOUT_LAYER, MAC_MODE_WIDE, true);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_codegen_neuron_layout),
+		cmocka_unit_test(test_codegen_layer_layout),
+		cmocka_unit_test(test_codegen_wide),
+		cmocka_unit_test(test_codegen_table),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,81 @@
+#ifndef _UNEURAL_TEST_COMMON_H_
+#define _UNEURAL_TEST_COMMON_H_
+
+/* Network set up shared by the tests. Included after cmocka.h and
+ * uneural.h */
+
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t test_seed = 1;
+
+/* Repeatable pseudo random numbers, the same sequence on every run */
+static inline uint32_t test_random(void)
+{
+	test_seed = test_seed * 1664525 + 1013904223;
+	return test_seed;
+}
+
+/* Uniform in (-range, range) */
+static inline fix16_t test_random_range(fix16_t range)
+{
+	return (fix16_t)((int64_t)(int32_t)test_random() * range >> 31);
+}
+
+/* Links layers[0] (the input) through layers[num_layers - 1] (the
+ * output) into a fresh network. The layers may have been part of
+ * another network before */
+static inline void test_connect_network(struct uneural_network *n,
+                                        struct uneural_layer **layers,
+                                        int num_layers)
+{
+	memset(n, 0, sizeof(*n));
+	for (int i = 0; i < num_layers; i++) {
+		layers[i]->prev = NULL;
+		layers[i]->next = NULL;
+	}
+
+	assert_int_equal(uneural_network_add_input_layer(n, layers[0]), 0);
+	for (int i = 1; i < num_layers - 1; i++) {
+		assert_int_equal(uneural_network_add_hidden_layer(n, layers[i]), 0);
+	}
+	assert_int_equal(uneural_network_add_output_layer(n, layers[num_layers - 1]), 0);
+}
+
+/* Allocates, initializes and attaches storage for n's current layout.
+ * The caller frees it once the network is done with */
+static inline fix16_t *test_attach_storage(struct uneural_network *n)
+{
+	ssize_t size = uneural_network_get_data_requirement(n);
+	fix16_t *storage;
+
+	assert_true(size > 0);
+	assert_int_equal(posix_memalign((void**)&storage, UNEURAL_CACHE_LINE, size), 0);
+	assert_int_equal(uneural_network_init_storage(storage, size), 0);
+	assert_int_equal(uneural_network_data_attach(n, storage, size), 0);
+
+	return storage;
+}
+
+/* Connects the layers, attaches storage, gives every layer past the
+ * input its entry of types and randomizes the weights. Returns the
+ * storage, see test_attach_storage */
+static inline fix16_t *test_create_network(struct uneural_network *n,
+                                           struct uneural_layer **layers,
+                                           int num_layers,
+                                           const enum neuron_type *types)
+{
+	fix16_t *storage;
+
+	test_connect_network(n, layers, num_layers);
+	storage = test_attach_storage(n);
+
+	for (int i = 1; i < num_layers; i++) {
+		assert_int_equal(uneural_network_set_layer_type(layers[i], types[i - 1]), 0);
+	}
+	assert_int_equal(uneural_network_randomize_weights(n), 0);
+
+	return storage;
+}
+
+#endif  /* _UNEURAL_TEST_COMMON_H_ */
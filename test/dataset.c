@@ -0,0 +1,141 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+DECLARE_UNEURAL_LAYER(input_layer, 3);
+DECLARE_UNEURAL_LAYER(hidden_layer, 4);
+DECLARE_UNEURAL_LAYER(output_layer, 1);
+
+static struct uneural_layer *layers[] = {
+	&input_layer, &hidden_layer, &output_layer
+};
+static const enum neuron_type types[] = { NEURON_TYPE_SIGMOID, NEURON_TYPE_SIGMOID };
+
+static struct uneural_network network;
+
+static const fix16_t inputs[4][3] = {
+	{F16(0), F16(0), F16(1)},
+	{F16(0), F16(1), F16(1)},
+	{F16(1), F16(0), F16(1)},
+	{F16(1), F16(1), F16(1)},
+};
+
+static const fix16_t targets[4][1] = {
+	{F16(0)},
+	{F16(1)},
+	{F16(1)},
+	{F16(0)},
+};
+
+static void test_dataset_widths(void **state)
+{
+	char path[] = "/tmp/uneural_datasetXXXXXX";
+	struct uneural_dataset data = {
+		.count = 4,
+		.inputs = &inputs[0][0],
+		.targets = &targets[0][0],
+	};
+	struct uneural_dataset mapped;
+	struct uneural_dataset_map map;
+	fix16_t mse, mapped_mse;
+	fix16_t *storage;
+	int fd;
+
+	storage = test_create_network(&network, layers, 3, types);
+
+	fd = mkstemp(path);
+	assert_true(fd >= 0);
+	close(fd);
+
+	assert_int_equal(uneural_dataset_save(path, &data, 3, 1), 0);
+	assert_int_equal(uneural_dataset_map(path, &mapped, &map), 0);
+	assert_int_equal(mapped.input_width, 3);
+	assert_int_equal(mapped.target_width, 1);
+
+	assert_int_equal(uneural_network_evaluate(&network, &data, &mse), 0);
+	assert_int_equal(uneural_network_evaluate(&network, &mapped, &mapped_mse), 0);
+	assert_int_equal(mse, mapped_mse);
+	assert_int_equal(uneural_dataset_unmap(&map), 0);
+
+	/* Rows two values narrower than the network reads */
+	assert_int_equal(uneural_dataset_save(path, &data, 2, 0), 0);
+	assert_int_equal(uneural_dataset_map(path, &mapped, &map), 0);
+	assert_int_equal(uneural_network_evaluate(&network, &mapped, &mse),
+			 -DATASET_SHAPE_MISMATCH);
+	assert_int_equal(uneural_dataset_unmap(&map), 0);
+
+	data.target_width = 2;
+	assert_int_equal(uneural_network_evaluate(&network, &data, &mse),
+			 -DATASET_SHAPE_MISMATCH);
+	assert_int_equal(uneural_dataset_save(path, &data, 3, 1),
+			 -DATASET_SHAPE_MISMATCH);
+
+	data.target_width = 0;
+	data.targets = NULL;
+	assert_int_equal(uneural_dataset_save(path, &data, 3, 1), -NULL_ARG);
+
+	unlink(path);
+	free(storage);
+}
+
+/* Overwrites the header field at offset with value */
+static void patch_header(const char *path, long offset, const void *value,
+                         size_t size)
+{
+	FILE *f = fopen(path, "r+b");
+
+	assert_non_null(f);
+	assert_int_equal(fseek(f, offset, SEEK_SET), 0);
+	assert_int_equal(fwrite(value, size, 1, f), 1);
+	assert_int_equal(fclose(f), 0);
+}
+
+static void test_dataset_bad_header(void **state)
+{
+	char path[] = "/tmp/uneural_datasetXXXXXX";
+	struct uneural_dataset data = {
+		.count = 4,
+		.inputs = &inputs[0][0],
+		.targets = &targets[0][0],
+	};
+	struct uneural_dataset mapped;
+	struct uneural_dataset_map map;
+	/* Times the 16 byte rows, 2^32 + 16, which wraps to 16 in a 32
+	 * bit size_t and would pass a multiplied out size check */
+	uint32_t count = 0x10000001;
+	uint16_t header_size = 0xFFFC;
+	int fd;
+
+	fd = mkstemp(path);
+	assert_true(fd >= 0);
+	close(fd);
+
+	assert_int_equal(uneural_dataset_save(path, &data, 3, 1), 0);
+	patch_header(path, 8, &count, sizeof(count));
+	assert_int_equal(uneural_dataset_map(path, &mapped, &map), -DATASET_FORMAT);
+
+	assert_int_equal(uneural_dataset_save(path, &data, 3, 1), 0);
+	patch_header(path, 6, &header_size, sizeof(header_size));
+	assert_int_equal(uneural_dataset_map(path, &mapped, &map), -DATASET_FORMAT);
+
+	unlink(path);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_dataset_widths),
+		cmocka_unit_test(test_dataset_bad_header),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,210 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+/* Checks the wide accumulation mode against an exact 128 bit sum, with
+ * weights and inputs large enough to overflow an int64 */
+
+#define NUM_INPUTS 20
+#define NUM_OUTPUTS 3
+#define NUM_SAMPLES 500
+
+DECLARE_UNEURAL_LAYER(small_input_layer, 4);
+DECLARE_UNEURAL_LAYER(small_output_layer, 1);
+DECLARE_UNEURAL_LAYER(input_layer, NUM_INPUTS);
+DECLARE_UNEURAL_LAYER(output_layer, NUM_OUTPUTS);
+
+static struct uneural_layer *small_layers[] = {
+	&small_input_layer, &small_output_layer
+};
+static struct uneural_layer *layers[] = { &input_layer, &output_layer };
+
+static struct uneural_network network;
+static fix16_t inputs[NUM_SAMPLES][NUM_INPUTS];
+static fix16_t outputs[NUM_SAMPLES][NUM_OUTPUTS];
+
+/* Runs inputs through the single sample, the context and the batched
+ * inference paths, which each have their own wide accumulation, and
+ * checks that they agree */
+static void activate_all(int num_inputs, int num_outputs, int count)
+{
+	struct uneural_ctx ctx;
+	fix16_t *ctx_data, *scratch;
+	fix16_t result[NUM_OUTPUTS];
+	ssize_t size;
+
+	size = uneural_ctx_get_data_requirement(&network);
+	assert_true(size > 0);
+	ctx_data = malloc(size);
+	assert_non_null(ctx_data);
+	assert_int_equal(uneural_ctx_init(&ctx, &network, ctx_data, size), 0);
+
+	size = uneural_network_get_batch_scratch_size(&network);
+	assert_true(size > 0);
+	scratch = malloc(size);
+	assert_non_null(scratch);
+	assert_int_equal(uneural_activate_network_batch(&network, &inputs[0][0], count,
+							&outputs[0][0], scratch), 0);
+
+	for (int s = 0; s < count; s++) {
+		/* The batch was run with rows num_inputs wide */
+		const fix16_t *in = &inputs[0][0] + s * num_inputs;
+		const fix16_t *batched = &outputs[0][0] + s * num_outputs;
+
+		assert_int_equal(uneural_activate_network(&network, in, result), 0);
+		assert_memory_equal(result, batched, num_outputs * sizeof(fix16_t));
+		assert_int_equal(uneural_activate_network_ctx(&ctx, in, result), 0);
+		assert_memory_equal(result, batched, num_outputs * sizeof(fix16_t));
+	}
+
+	free(scratch);
+	free(ctx_data);
+}
+
+/* Four products of fix16_maximum squared sum to almost 2^64, so the
+ * wide sum has to saturate just as the saturating one does */
+static void test_mac_mode_wide_maximum(void **state)
+{
+	static const enum neuron_type types[] = { NEURON_TYPE_SIGMOID };
+	struct uneural_neuron *neuron = &small_output_layer.neurons[0];
+	fix16_t *in = &inputs[0][0];
+	fix16_t *out = &outputs[0][0];
+	fix16_t *storage;
+
+	for (int mode = MAC_MODE_SATURATE; mode <= MAC_MODE_WIDE; mode++) {
+		storage = test_create_network(&network, small_layers, 2, types);
+		assert_int_equal(uneural_network_set_mac_mode(&network, mode), 0);
+
+		*neuron->bias = 0;
+		for (int i = 0; i < 4; i++) {
+			neuron->weights[i] = fix16_maximum;
+			in[i] = fix16_maximum;
+			in[4 + i] = fix16_minimum;
+		}
+
+		activate_all(4, 1, 2);
+		assert_int_equal(out[0], F16(1));
+
+		/* Only the wide sum, as the saturating one ends on
+		 * fix16_minimum, which fix16_sadd takes for fix16_overflow */
+		if (mode == MAC_MODE_WIDE) {
+			assert_int_equal(out[1], uneural_activate_sigmoid(fix16_minimum));
+		}
+
+		free(storage);
+	}
+}
+
+/* fix16_t values, weighted towards the extremes */
+static fix16_t random_value(void)
+{
+	uint32_t r = test_random();
+
+	switch (r >> 29) {
+	case 0:
+		return fix16_maximum;
+	case 1:
+		return fix16_minimum;
+	case 2:
+		return fix16_maximum - (r & 0xFFFF);
+	case 3:
+		return fix16_minimum + (r & 0xFFFF);
+	default:
+		return (fix16_t)r;
+	}
+}
+
+static fix16_t exact_sum(fix16_t bias, const fix16_t *weights, const fix16_t *in)
+{
+	__int128 sum = (__int128)bias * 65536;
+	__int128 result;
+
+	for (int j = 0; j < NUM_INPUTS; j++) {
+		sum += (int64_t)weights[j] * in[j];
+	}
+
+	result = (sum + 0x7FFF + (sum >= 0)) >> 16;
+	if (result > fix16_maximum) {
+		return fix16_maximum;
+	}
+	if (result < fix16_minimum) {
+		return fix16_minimum;
+	}
+	return (fix16_t)result;
+}
+
+static void check_exact(enum storage_layout layout)
+{
+	fix16_t *storage;
+
+	test_connect_network(&network, layers, 2);
+	assert_int_equal(uneural_network_set_storage_layout(&network, layout), 0);
+	assert_int_equal(uneural_network_set_mac_mode(&network, MAC_MODE_WIDE), 0);
+	storage = test_attach_storage(&network);
+	assert_int_equal(uneural_network_set_layer_type(&output_layer, NEURON_TYPE_RELU), 0);
+
+	for (int i = 0; i < NUM_OUTPUTS; i++) {
+		struct uneural_neuron *neuron = &output_layer.neurons[i];
+
+		*neuron->bias = random_value();
+		for (int j = 0; j < NUM_INPUTS; j++) {
+			neuron->weights[j] = random_value();
+		}
+	}
+
+	/* Products that cancel out in the end, but whose running sums
+	 * go far past the int64 range on the way */
+	for (int j = 0; j < NUM_INPUTS; j++) {
+		output_layer.neurons[0].weights[j] = (j < NUM_INPUTS / 2) ?
+			fix16_maximum : fix16_minimum;
+	}
+	*output_layer.neurons[0].bias = F16(1);
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		for (int j = 0; j < NUM_INPUTS; j++) {
+			inputs[s][j] = (s % 4) ? random_value() : fix16_maximum;
+		}
+	}
+
+	activate_all(NUM_INPUTS, NUM_OUTPUTS, NUM_SAMPLES);
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		for (int i = 0; i < NUM_OUTPUTS; i++) {
+			struct uneural_neuron *neuron = &output_layer.neurons[i];
+			fix16_t sum = exact_sum(*neuron->bias, neuron->weights,
+						inputs[s]);
+
+			assert_int_equal(outputs[s][i], uneural_activate_relu(sum));
+		}
+	}
+
+	free(storage);
+}
+
+static void test_mac_mode_wide_exact_neuron_layout(void **state)
+{
+	check_exact(STORAGE_LAYOUT_NEURON);
+}
+
+static void test_mac_mode_wide_exact_layer_layout(void **state)
+{
+	check_exact(STORAGE_LAYOUT_LAYER);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_mac_mode_wide_maximum),
+		cmocka_unit_test(test_mac_mode_wide_exact_neuron_layout),
+		cmocka_unit_test(test_mac_mode_wide_exact_layer_layout),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
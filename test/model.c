@@ -0,0 +1,76 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+DECLARE_UNEURAL_LAYER(input_layer, 3);
+DECLARE_UNEURAL_LAYER(hidden_layer, 4);
+DECLARE_UNEURAL_LAYER(output_layer, 2);
+
+static struct uneural_layer *layers[] = {
+	&input_layer, &hidden_layer, &output_layer
+};
+static const enum neuron_type types[] = { NEURON_TYPE_TANH, NEURON_TYPE_SIGMOID };
+
+static struct uneural_network network;
+
+static void test_model_layer_types(void **state)
+{
+	char path[] = "/tmp/uneural_modelXXXXXX";
+	struct uneural_model model;
+	struct uneural_network built;
+	static uint64_t buf[64];
+	fix16_t input[3] = {F16(0.5), F16(-1), F16(2)};
+	fix16_t expected[2], actual[2];
+	fix16_t *storage;
+	int fd;
+
+	storage = test_create_network(&network, layers, 3, types);
+
+	/* One hidden neuron of its own type */
+	*hidden_layer.neurons[2].n_type = NEURON_TYPE_RELU;
+
+	fd = mkstemp(path);
+	assert_true(fd >= 0);
+	close(fd);
+
+	assert_int_equal(uneural_model_save(&network, path), 0);
+	assert_int_equal(uneural_model_map(path, &model, true), 0);
+	assert_int_equal(model.num_layers, 3);
+	assert_int_equal(model.layers[0].n_type, 0);
+	assert_int_equal(model.layers[1].n_type, UNEURAL_MODEL_MIXED_TYPES);
+	assert_int_equal(model.layers[2].n_type, NEURON_TYPE_SIGMOID);
+
+	assert_in_range(uneural_model_get_network_size(&model), 0, sizeof(buf));
+	assert_int_equal(uneural_model_build(&model, &built, buf, sizeof(buf)), 0);
+	assert_int_equal(uneural_activate_network(&network, input, expected), 0);
+	assert_int_equal(uneural_activate_network(&built, input, actual), 0);
+	assert_memory_equal(actual, expected, sizeof(expected));
+
+	/* The mapping is private, so the blob can be changed under the
+	 * layer table without touching the file: one output neuron no
+	 * longer matches its layer's entry */
+	*built.output->neurons[1].n_type = NEURON_TYPE_TANH;
+	assert_int_equal(uneural_model_build(&model, &built, buf, sizeof(buf)),
+			 -MODEL_FORMAT);
+
+	assert_int_equal(uneural_model_unmap(&model), 0);
+	unlink(path);
+	free(storage);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_model_layer_types),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,176 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+/* Steps each optimizer on fixed gradients for a single neuron with one
+ * input, whose bias and weight start at zero, and checks the resulting
+ * parameters against the update rules worked through by hand */
+
+DECLARE_UNEURAL_LAYER(input_layer, 1);
+DECLARE_UNEURAL_LAYER(output_layer, 1);
+
+static struct uneural_layer *layers[] = { &input_layer, &output_layer };
+static const enum neuron_type types[] = { NEURON_TYPE_SIGMOID };
+
+static struct uneural_network network;
+
+/* Applies gradients (bias, weight) once per step, each summed over
+ * batch_size samples, and checks the parameters after every step */
+static void check_steps(enum optimizer_type type,
+                        fix16_t rate,
+                        uint32_t batch_size,
+                        int num_steps,
+                        const fix16_t (*grads)[2],
+                        const fix16_t (*expected)[2])
+{
+	struct uneural_optimizer opt;
+	struct uneural_neuron *neuron = &output_layer.neurons[0];
+	fix16_t state[4], buffer[2];
+	fix16_t *storage;
+
+	storage = test_create_network(&network, layers, 2, types);
+	*neuron->bias = 0;
+	neuron->weights[0] = 0;
+
+	assert_in_range(uneural_optimizer_get_state_size(&network, type), 0,
+			sizeof(state));
+	assert_int_equal(uneural_network_get_gradient_size(&network), sizeof(buffer));
+	assert_int_equal(uneural_optimizer_init(&opt, &network, type, rate,
+						state, sizeof(state)), 0);
+
+	for (int t = 0; t < num_steps; t++) {
+		buffer[0] = grads[t][0];
+		buffer[1] = grads[t][1];
+		assert_int_equal(uneural_optimizer_apply(&opt, &network, buffer,
+							 batch_size), 0);
+		assert_int_equal(buffer[0], 0);
+		assert_int_equal(buffer[1], 0);
+		assert_int_equal(*neuron->bias, expected[t][0]);
+		assert_int_equal(neuron->weights[0], expected[t][1]);
+	}
+
+	free(storage);
+}
+
+/* SGD keeps no state, so none need be given */
+static void test_optimizer_sgd(void **state)
+{
+	struct uneural_optimizer opt;
+	struct uneural_neuron *neuron = &output_layer.neurons[0];
+	fix16_t buffer[2] = { F16(-2), F16(1) };
+	fix16_t *storage;
+
+	storage = test_create_network(&network, layers, 2, types);
+	*neuron->bias = 0;
+	neuron->weights[0] = 0;
+
+	assert_int_equal(uneural_optimizer_get_state_size(&network, OPTIMIZER_SGD), 0);
+	assert_int_equal(uneural_optimizer_init(&opt, &network, OPTIMIZER_SGD,
+						F16(0.5), NULL, 0), 0);
+	assert_int_equal(uneural_optimizer_apply(&opt, &network, buffer, 1), 0);
+	assert_int_equal(*neuron->bias, F16(-1));
+	assert_int_equal(neuron->weights[0], F16(0.5));
+
+	free(storage);
+}
+
+/* v = 0.9 v + g, w += 0.5 v. Gradients are summed over two samples
+ * here, so g is half the sum */
+static void test_optimizer_momentum(void **state)
+{
+	static const fix16_t grads[][2] = {
+		{ F16(-4), F16(2) },
+		{ F16(-4), F16(2) },
+		{ 0, 0 },
+	};
+	static const fix16_t expected[][2] = {
+		/* v = -2, 1 */
+		{ F16(-1), F16(0.5) },
+		/* v = -3.8, 1.9 */
+		{ F16(-2.9), F16(1.45) },
+		/* v = -3.42, 1.71, so -4.61 and 2.305 give or take a
+		 * unit of rounding */
+		{ -302120, 151060 },
+	};
+
+	check_steps(OPTIMIZER_MOMENTUM, F16(0.5), 2, 3, grads, expected);
+}
+
+/* v = 0.9 v + g, w += 0.5 (g + 0.9 v) */
+static void test_optimizer_nesterov(void **state)
+{
+	static const fix16_t grads[][2] = {
+		{ F16(-2), F16(1) },
+		{ F16(-2), F16(1) },
+	};
+	static const fix16_t expected[][2] = {
+		/* v = -2, 1: steps of -1.9, 0.95 */
+		{ F16(-1.9), F16(0.95) },
+		/* v = -3.8, 1.9: steps of -2.71, 1.355 */
+		{ -302120, 151060 },
+	};
+
+	check_steps(OPTIMIZER_NESTEROV, F16(0.5), 1, 2, grads, expected);
+}
+
+/* After bias correction Adam's first step is rate * g / (|g| + eps),
+ * just under the rate (6547 units) whatever the size of g. With g
+ * unchanged the second step is the same to within a unit */
+static void test_optimizer_adam(void **state)
+{
+	static const fix16_t grads[][2] = {
+		{ F16(-1), F16(4) },
+		{ F16(-1), F16(4) },
+	};
+	static const fix16_t expected[][2] = {
+		{ -6547, 6552 },
+		{ -13093, 13103 },
+	};
+
+	check_steps(OPTIMIZER_ADAM, F16(0.1), 1, 2, grads, expected);
+}
+
+/* Only the signs count: the step grows by 1.2 while the sign holds,
+ * halves when it flips (without moving the weight) and then carries on
+ * from the halved step. A sum of one unit over four samples still has a
+ * sign, even though its mean rounds to zero */
+static void test_optimizer_rprop(void **state)
+{
+	static const fix16_t grads[][2] = {
+		{ -1, 1 },
+		{ F16(-3), F16(2) },
+		{ F16(1), F16(-5) },
+		{ F16(1), F16(-5) },
+	};
+	static const fix16_t expected[][2] = {
+		/* Steps of 0.1 */
+		{ F16(-0.1), F16(0.1) },
+		/* Steps of 0.12 */
+		{ -14419, 14419 },
+		/* Step halved to 0.06 */
+		{ -14419, 14419 },
+		{ -10486, 10486 },
+	};
+
+	check_steps(OPTIMIZER_RPROP, F16(0.1), 4, 4, grads, expected);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_optimizer_sgd),
+		cmocka_unit_test(test_optimizer_momentum),
+		cmocka_unit_test(test_optimizer_nesterov),
+		cmocka_unit_test(test_optimizer_adam),
+		cmocka_unit_test(test_optimizer_rprop),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,137 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+/* Checks that the parallel trainer updates the weights exactly as
+ * accumulating the same batch through uneural_network_compute_gradients
+ * on one thread does, whatever the number of threads */
+
+#define NUM_INPUTS 5
+#define NUM_OUTPUTS 3
+#define NUM_SAMPLES 200
+
+DECLARE_UNEURAL_LAYER(input_layer, NUM_INPUTS);
+DECLARE_UNEURAL_LAYER(hidden_layer, 7);
+DECLARE_UNEURAL_LAYER(output_layer, NUM_OUTPUTS);
+
+static struct uneural_layer *layers[] = {
+	&input_layer, &hidden_layer, &output_layer
+};
+static const enum neuron_type types[] = { NEURON_TYPE_TANH, NEURON_TYPE_SIGMOID };
+
+static struct uneural_network network;
+static fix16_t inputs[NUM_SAMPLES][NUM_INPUTS];
+static fix16_t targets[NUM_SAMPLES][NUM_OUTPUTS];
+
+/* Trains a few batches serially, saving the weights after each into
+ * expected, starting from the weights in initial */
+static void train_serial(const fix16_t *initial, fix16_t *expected, int num_batches)
+{
+	ssize_t size = network.storage_size;
+	fix16_t *grads, *scratch;
+
+	grads = calloc(1, uneural_network_get_gradient_size(&network));
+	scratch = malloc(uneural_network_get_training_scratch_size(&network));
+	assert_non_null(grads);
+	assert_non_null(scratch);
+
+	memcpy(network.storage, initial, size);
+
+	for (int b = 0; b < num_batches; b++) {
+		for (int s = 0; s < NUM_SAMPLES; s++) {
+			assert_int_equal(uneural_network_compute_gradients(&network, inputs[s],
+									   targets[s], grads,
+									   scratch, NULL), 0);
+		}
+		assert_int_equal(uneural_network_apply_gradients(&network, grads, F16(0.5),
+								 NUM_SAMPLES), 0);
+		memcpy((uint8_t*)expected + b * size, network.storage, size);
+	}
+
+	free(scratch);
+	free(grads);
+}
+
+static void check_parallel(const fix16_t *initial, const fix16_t *expected,
+                           int num_batches, uint16_t num_threads)
+{
+	ssize_t size = network.storage_size;
+	ssize_t scratch_size;
+	fix16_t *scratch;
+
+	scratch_size = uneural_network_get_parallel_scratch_size(&network, num_threads);
+	assert_true(scratch_size > 0);
+	assert_int_equal(posix_memalign((void**)&scratch, UNEURAL_CACHE_LINE,
+					scratch_size), 0);
+
+	memcpy(network.storage, initial, size);
+
+	for (int b = 0; b < num_batches; b++) {
+		assert_int_equal(uneural_network_train_parallel(&network, &inputs[0][0],
+								&targets[0][0],
+								NUM_SAMPLES, F16(0.5),
+								num_threads, scratch), 0);
+		assert_memory_equal(network.storage,
+				    (const uint8_t*)expected + b * size, size);
+	}
+
+	free(scratch);
+}
+
+static void test_parallel_matches_serial(void **state)
+{
+	const int num_batches = 3;
+	fix16_t *storage, *initial, *expected;
+	ssize_t size;
+
+	storage = test_create_network(&network, layers, 3, types);
+	size = network.storage_size;
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			inputs[s][i] = test_random_range(F16(2));
+		}
+		for (int i = 0; i < NUM_OUTPUTS; i++) {
+			targets[s][i] = test_random() % fix16_one;
+		}
+	}
+
+	initial = malloc(size);
+	expected = malloc(num_batches * size);
+	assert_non_null(initial);
+	assert_non_null(expected);
+	memcpy(initial, network.storage, size);
+
+	train_serial(initial, expected, num_batches);
+
+	/* The weights have to move for the comparison to mean anything */
+	assert_true(memcmp(initial, expected, size) != 0);
+
+	check_parallel(initial, expected, num_batches, 1);
+	check_parallel(initial, expected, num_batches, 4);
+	check_parallel(initial, expected, num_batches, 7);
+
+	/* More threads than samples, and more than UNEURAL_MAX_THREADS */
+	check_parallel(initial, expected, num_batches, 65535);
+
+	free(expected);
+	free(initial);
+	free(storage);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_parallel_matches_serial),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
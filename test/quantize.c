@@ -0,0 +1,194 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+/* Checks the int8 quantized network against the fix16 network it was
+ * made from */
+
+#define NUM_INPUTS 6
+#define NUM_OUTPUTS 4
+#define NUM_SAMPLES 2000
+
+DECLARE_UNEURAL_LAYER(input_layer, NUM_INPUTS);
+DECLARE_UNEURAL_LAYER(hidden1_layer, 9);
+DECLARE_UNEURAL_LAYER(hidden2_layer, 5);
+DECLARE_UNEURAL_LAYER(output_layer, NUM_OUTPUTS);
+
+static struct uneural_layer *layers[] = {
+	&input_layer, &hidden1_layer, &hidden2_layer, &output_layer
+};
+
+static struct uneural_network network;
+static fix16_t *storage;
+static uint32_t qdata[256];
+
+static void create_network(enum storage_layout layout)
+{
+	/* The layers are shared between the networks built here */
+	test_connect_network(&network, layers, 4);
+	assert_int_equal(uneural_network_set_storage_layout(&network, layout), 0);
+
+	/* Quantized layers sum their products in 64 bits and round once,
+	 * as the wide mode does */
+	assert_int_equal(uneural_network_set_mac_mode(&network, MAC_MODE_WIDE), 0);
+
+	free(storage);
+	storage = test_attach_storage(&network);
+
+	assert_int_equal(uneural_network_set_layer_type(&hidden1_layer, NEURON_TYPE_TANH), 0);
+	assert_int_equal(uneural_network_set_layer_type(&hidden2_layer, NEURON_TYPE_RELU), 0);
+	assert_int_equal(uneural_network_set_layer_type(&output_layer, NEURON_TYPE_SIGMOID), 0);
+}
+
+static void quantize(struct uneural_qnetwork *q)
+{
+	ssize_t size = uneural_qnetwork_get_data_requirement(&network);
+
+	assert_in_range(size, 0, sizeof(qdata));
+	assert_int_equal(uneural_qnetwork_quantize(&network, qdata, size), 0);
+	assert_int_equal(uneural_qnetwork_attach(q, qdata, size), 0);
+	assert_in_range(uneural_qnetwork_get_scratch_size(q), 0, 2 * 9 * sizeof(fix16_t));
+}
+
+/* With every weight a multiple of its layer's step, and the largest
+ * one 127 steps, quantization loses nothing and the results must be
+ * identical, saturation included */
+static void check_exact(enum storage_layout layout)
+{
+	struct uneural_qnetwork q;
+	fix16_t scratch[2 * 9];
+
+	create_network(layout);
+
+	for (int l = 1; l < 4; l++) {
+		fix16_t scale = 1 + (test_random() >> 20);
+
+		for (int i = 0; i < layers[l]->num_neurons; i++) {
+			struct uneural_neuron *neuron = &layers[l]->neurons[i];
+
+			*neuron->bias = test_random_range(F16(4));
+			for (int j = 0; j < layers[l - 1]->num_neurons; j++) {
+				neuron->weights[j] = scale *
+					((int32_t)(test_random() % 255) - 127);
+			}
+		}
+
+		layers[l]->neurons[0].weights[0] = -127 * scale;
+	}
+
+	quantize(&q);
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		fix16_t input[NUM_INPUTS];
+		fix16_t expected[NUM_OUTPUTS];
+		fix16_t actual[NUM_OUTPUTS];
+
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			/* Some samples large enough to saturate */
+			input[i] = (s % 8) ? test_random_range(F16(8)) :
+				(fix16_t)test_random();
+		}
+
+		assert_int_equal(uneural_activate_network(&network, input, expected), 0);
+		assert_int_equal(uneural_qnetwork_activate(&q, input, actual, scratch), 0);
+		assert_memory_equal(actual, expected, sizeof(expected));
+	}
+}
+
+static void test_quantize_exact_neuron_layout(void **state)
+{
+	check_exact(STORAGE_LAYOUT_NEURON);
+}
+
+static void test_quantize_exact_layer_layout(void **state)
+{
+	check_exact(STORAGE_LAYOUT_LAYER);
+}
+
+/* For arbitrary weights each one is off by at most half a step, so a
+ * neuron's sum is off by at most half a step times the sum of its
+ * input magnitudes. The first hidden layer sees the inputs directly */
+static void test_quantize_error(void **state)
+{
+	struct uneural_qnetwork q;
+	fix16_t scratch[2 * 9];
+	fix16_t scale;
+	fix16_t max = 0;
+
+	create_network(STORAGE_LAYOUT_NEURON);
+	assert_int_equal(uneural_network_set_layer_type(&hidden1_layer, NEURON_TYPE_RELU), 0);
+
+	for (int l = 1; l < 4; l++) {
+		for (int i = 0; i < layers[l]->num_neurons; i++) {
+			struct uneural_neuron *neuron = &layers[l]->neurons[i];
+
+			*neuron->bias = test_random_range(F16(2));
+			for (int j = 0; j < layers[l - 1]->num_neurons; j++) {
+				neuron->weights[j] = test_random_range(F16(3));
+				if (l == 1) {
+					max = fix16_max(max, abs(neuron->weights[j]));
+				}
+			}
+		}
+	}
+
+	scale = (max + 126) / 127;
+
+	quantize(&q);
+
+	for (int s = 0; s < NUM_SAMPLES; s++) {
+		fix16_t input[NUM_INPUTS];
+		fix16_t outputs[NUM_OUTPUTS];
+		int64_t bound = 0;
+
+		for (int i = 0; i < NUM_INPUTS; i++) {
+			input[i] = test_random_range(F16(8));
+			bound += abs(input[i]);
+		}
+		bound = ((bound * (scale / 2 + 1)) >> 16) + 1;
+
+		/* The fix16 network keeps each neuron's output, and the
+		 * quantized one leaves the first layer's outputs at the
+		 * start of its scratch */
+		assert_int_equal(uneural_activate_network(&network, input, outputs), 0);
+		assert_int_equal(uneural_qnetwork_activate(&q, input, outputs, scratch), 0);
+
+		for (int i = 0; i < hidden1_layer.num_neurons; i++) {
+			fix16_t exact = hidden1_layer.neurons[i].output;
+
+			assert_in_range(scratch[i], exact - bound, exact + bound);
+		}
+	}
+}
+
+static void test_quantize_mixed_types(void **state)
+{
+	ssize_t size;
+
+	create_network(STORAGE_LAYOUT_NEURON);
+	*hidden2_layer.neurons[3].n_type = NEURON_TYPE_TANH;
+
+	size = uneural_qnetwork_get_data_requirement(&network);
+	assert_int_equal(uneural_qnetwork_quantize(&network, qdata, size),
+			 -MIXED_LAYER_TYPES);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_quantize_exact_neuron_layout),
+		cmocka_unit_test(test_quantize_exact_layer_layout),
+		cmocka_unit_test(test_quantize_error),
+		cmocka_unit_test(test_quantize_mixed_types),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
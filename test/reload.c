@@ -0,0 +1,159 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+#define NUM_READERS 2
+
+DECLARE_UNEURAL_LAYER(input_layer, 3);
+DECLARE_UNEURAL_LAYER(hidden_layer, 4);
+DECLARE_UNEURAL_LAYER(output_layer, 2);
+DECLARE_UNEURAL_LAYER(next_input_layer, 3);
+DECLARE_UNEURAL_LAYER(next_hidden_layer, 4);
+DECLARE_UNEURAL_LAYER(next_output_layer, 2);
+
+static struct uneural_layer *layers[] = {
+	&input_layer, &hidden_layer, &output_layer
+};
+static struct uneural_layer *next_layers[] = {
+	&next_input_layer, &next_hidden_layer, &next_output_layer
+};
+static const enum neuron_type types[] = { NEURON_TYPE_TANH, NEURON_TYPE_SIGMOID };
+
+static struct uneural_network network;
+static struct uneural_network next_network;
+static uint8_t slots[NUM_READERS * UNEURAL_CACHE_LINE]
+	__attribute__((aligned(UNEURAL_CACHE_LINE)));
+
+static void test_reload_reader_index(void **state)
+{
+	struct uneural_reload reload;
+	struct uneural_network *old;
+	fix16_t input[3] = {F16(0.5), F16(-1), F16(2)};
+	fix16_t expected[2], actual[2];
+	fix16_t activations[16];
+	fix16_t *storage;
+
+	storage = test_create_network(&network, layers, 3, types);
+	assert_int_equal(uneural_activate_network(&network, input, expected), 0);
+
+	assert_int_equal(uneural_reload_init(&reload, &network, slots, sizeof(slots),
+					     NUM_READERS), 0);
+
+	for (uint16_t reader = 0; reader < NUM_READERS; reader++) {
+		assert_true(uneural_reload_enter(&reload, reader) == &network);
+		assert_int_equal(uneural_reload_exit(&reload, reader), 0);
+		assert_int_equal(uneural_reload_activate(&reload, reader, activations,
+							 sizeof(activations),
+							 input, actual), 0);
+		assert_memory_equal(actual, expected, sizeof(expected));
+	}
+
+	assert_null(uneural_reload_enter(&reload, NUM_READERS));
+	assert_null(uneural_reload_enter(NULL, 0));
+	assert_int_equal(uneural_reload_exit(&reload, NUM_READERS), -RELOAD_BAD_READER);
+	assert_int_equal(uneural_reload_exit(NULL, 0), -NULL_ARG);
+	assert_int_equal(uneural_reload_activate(&reload, NUM_READERS, activations,
+						 sizeof(activations), input, actual),
+			 -RELOAD_BAD_READER);
+
+	/* Nothing out of range was written, so publishing does not wait
+	 * on a stray slot */
+	assert_int_equal(uneural_reload_publish(&reload, &network, &old), 0);
+	assert_true(old == &network);
+	free(storage);
+}
+
+struct publisher {
+	struct uneural_reload *reload;
+	struct uneural_network *old;
+	int res;
+	bool done;
+};
+
+static void *publish(void *arg)
+{
+	struct publisher *p = arg;
+
+	p->res = uneural_reload_publish(p->reload, &next_network, &p->old);
+	__atomic_store_n(&p->done, true, __ATOMIC_SEQ_CST);
+
+	return NULL;
+}
+
+/* Reader 0 holds the first network while another thread publishes the
+ * second. The publisher has to wait for reader 0 to exit before handing
+ * the first network back, while readers entering after the swap
+ * already get the second one */
+static void test_reload_publish_waits(void **state)
+{
+	struct uneural_reload reload;
+	struct publisher publisher = { .reload = &reload };
+	const struct uneural_network *held;
+	struct uneural_ctx ctx;
+	pthread_t thread;
+	fix16_t input[3] = {F16(0.5), F16(-1), F16(2)};
+	fix16_t expected[2], next_expected[2], actual[2];
+	fix16_t activations[16];
+	fix16_t *storage, *next_storage;
+
+	storage = test_create_network(&network, layers, 3, types);
+	next_storage = test_create_network(&next_network, next_layers, 3, types);
+	assert_int_equal(uneural_activate_network(&network, input, expected), 0);
+	assert_int_equal(uneural_activate_network(&next_network, input, next_expected), 0);
+	assert_true(memcmp(expected, next_expected, sizeof(expected)) != 0);
+
+	assert_int_equal(uneural_reload_init(&reload, &network, slots, sizeof(slots),
+					     NUM_READERS), 0);
+
+	held = uneural_reload_enter(&reload, 0);
+	assert_true(held == &network);
+
+	assert_int_equal(pthread_create(&thread, NULL, publish, &publisher), 0);
+
+	while (__atomic_load_n(&reload.current, __ATOMIC_SEQ_CST) != &next_network) {
+		sched_yield();
+	}
+
+	/* Swapped, but reader 0 may still be using the first network */
+	assert_int_equal(uneural_reload_activate(&reload, 1, activations,
+						 sizeof(activations), input, actual), 0);
+	assert_memory_equal(actual, next_expected, sizeof(next_expected));
+
+	usleep(100000);
+	assert_false(__atomic_load_n(&publisher.done, __ATOMIC_SEQ_CST));
+
+	assert_int_equal(uneural_ctx_init(&ctx, held, activations, sizeof(activations)), 0);
+	assert_int_equal(uneural_activate_network_ctx(&ctx, input, actual), 0);
+	assert_memory_equal(actual, expected, sizeof(expected));
+	assert_int_equal(uneural_reload_exit(&reload, 0), 0);
+
+	assert_int_equal(pthread_join(thread, NULL), 0);
+	assert_true(publisher.done);
+	assert_int_equal(publisher.res, 0);
+	assert_true(publisher.old == &network);
+
+	assert_true(uneural_reload_enter(&reload, 0) == &next_network);
+	assert_int_equal(uneural_reload_exit(&reload, 0), 0);
+
+	free(next_storage);
+	free(storage);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_reload_reader_index),
+		cmocka_unit_test(test_reload_publish_waits),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
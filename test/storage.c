@@ -0,0 +1,75 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <cmocka.h>
+
+#include <uneural.h>
+
+#include "common.h"
+
+DECLARE_UNEURAL_LAYER(input_layer, 3);
+DECLARE_UNEURAL_LAYER(hidden_layer, 4);
+DECLARE_UNEURAL_LAYER(output_layer, 2);
+
+static struct uneural_layer *layers[] = {
+	&input_layer, &hidden_layer, &output_layer
+};
+static const enum neuron_type types[] = { NEURON_TYPE_TANH, NEURON_TYPE_SIGMOID };
+
+static struct uneural_network network;
+
+/* Storage attached with uneural_network_data_attach_const is placed in
+ * a read-only page here, so any write through it faults */
+static void test_storage_read_only(void **state)
+{
+	fix16_t input[3] = {F16(0.5), F16(-1), F16(2)};
+	fix16_t expected[2], actual[2];
+	fix16_t scratch[64];
+	fix16_t *storage;
+	ssize_t size;
+	void *page;
+
+	storage = test_create_network(&network, layers, 3, types);
+	size = network.storage_size;
+	assert_in_range(size, 0, 4096);
+	assert_int_equal(uneural_activate_network(&network, input, expected), 0);
+
+	page = mmap(NULL, 4096, PROT_READ | PROT_WRITE,
+		    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	assert_true(page != MAP_FAILED);
+	memcpy(page, storage, size);
+	assert_int_equal(mprotect(page, 4096, PROT_READ), 0);
+
+	assert_int_equal(uneural_network_data_attach_const(&network, page, size), 0);
+	assert_int_equal(uneural_activate_network(&network, input, actual), 0);
+	assert_memory_equal(actual, expected, sizeof(expected));
+
+	assert_int_equal(uneural_network_set_layer_type(&hidden_layer, NEURON_TYPE_RELU),
+			 -DATA_STORAGE_READ_ONLY);
+	assert_int_equal(uneural_network_randomize_weights(&network),
+			 -DATA_STORAGE_READ_ONLY);
+	assert_in_range(uneural_network_get_training_scratch_size(&network), 0,
+			sizeof(scratch));
+	assert_int_equal(uneural_network_backprop(&network, input, expected,
+						  F16(0.1), scratch, actual),
+			 -DATA_STORAGE_READ_ONLY);
+
+	/* Attaching writable storage again lifts the restriction */
+	assert_int_equal(uneural_network_data_attach(&network, storage, size), 0);
+	assert_int_equal(uneural_network_set_layer_type(&hidden_layer, NEURON_TYPE_RELU), 0);
+
+	munmap(page, 4096);
+	free(storage);
+}
+
+int main(void)
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(test_storage_read_only),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}